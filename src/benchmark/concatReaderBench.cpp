@@ -0,0 +1,76 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <gryltools/stackreader.hpp>
+#include <gryltools/concatsource.hpp>
+#include <gryltools/execution_time.hpp>
+
+/*! Reads many small files (as rotated logs) - one reader per file opened
+ *  serially, against the ConcatReader opening the next files in background.
+ */
+
+const size_t FILE_COUNT = 5000;
+const size_t ITERATIONS = 5;
+
+size_t countLinesPerFile( const std::vector< std::string >& paths ){
+    size_t lines = 0;
+    for( const auto& path : paths ){
+        gtools::StackReader rdr( path.c_str(), 256, 4096 );
+        while( rdr.skipUntilChar( '\n' ) ){
+            rdr.getChar();
+            lines++;
+        }
+    }
+    return lines;
+}
+
+size_t countLinesConcatenated( const std::vector< std::string >& paths ){
+    size_t lines = 0;
+    gtools::ConcatReader rdr( paths, 256, 4096 );
+    while( rdr.skipUntilChar( '\n' ) ){
+        rdr.getChar();
+        lines++;
+    }
+    return lines;
+}
+
+int main(){
+    char dirTemplate[] = "/tmp/concat_bench_XXXXXX";
+    if( !mkdtemp( dirTemplate ) )
+        return 1;
+
+    std::vector< std::string > paths;
+    for( size_t i = 0; i < FILE_COUNT; i++ ){
+        std::string path = std::string( dirTemplate ) + "/app.log." + std::to_string( i );
+        FILE* file = std::fopen( path.c_str(), "wb" );
+        if( !file )
+            return 1;
+        for( size_t j = 0; j < 20 + rand() % 40; j++ )
+            std::fprintf( file, "2023-10-11 12:%02d:%02d INFO request %zu served in %d ms\n",
+                          (int)(j % 60), (int)(i % 60), i * 100 + j, rand() % 500 );
+        std::fclose( file );
+        paths.push_back( path );
+    }
+
+    using namespace gtools;
+    size_t perFileCount = 0, concatCount = 0;
+
+    std::cout<< "\n"<< FILE_COUNT <<" files, reader per file:\nExecution took " <<
+    functionExecTimeReturnCallback( countLinesPerFile, ITERATIONS, [&](size_t cnt){
+        perFileCount = cnt; }, CALLBACK_ONLY_AT_THE_END, paths ).count()
+    << " s\n";
+
+    std::cout<< "\n"<< FILE_COUNT <<" files, ConcatReader:\nExecution took " <<
+    functionExecTimeReturnCallback( countLinesConcatenated, ITERATIONS, [&](size_t cnt){
+        concatCount = cnt; }, CALLBACK_ONLY_AT_THE_END, paths ).count()
+    << " s\n";
+
+    std::cout<< "\nLine counts: "<< perFileCount <<" / "<< concatCount <<"\n";
+
+    for( const auto& path : paths )
+        std::remove( path.c_str() );
+    std::remove( dirTemplate );
+    return 0;
+}
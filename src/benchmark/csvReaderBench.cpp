@@ -0,0 +1,94 @@
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <gryltools/stackreader.hpp>
+#include <gryltools/csvreader.hpp>
+#include <gryltools/execution_time.hpp>
+
+/*! Splits a CSV file to the fields - byte by byte with the quotes tracked,
+ *  by getStringUntilDelim() (which doesn't know quotes), and by CsvReader.
+ */
+
+const size_t RECORD_COUNT = 300000;
+const size_t ITERATIONS = 3;
+const size_t BUFFER_SIZE = 256 * 1024;
+
+size_t countFieldsByChars( const std::string& path ){
+    gtools::StackReader rdr( path.c_str(), 256, BUFFER_SIZE );
+    size_t fields = 0;
+    bool inQuotes = false, any = false;
+    char c;
+    while( rdr.getChar( c ) ){
+        any = true;
+        if( c == '"' )
+            inQuotes = !inQuotes;
+        else if( !inQuotes && ( c == ',' || c == '\n' ) ){
+            fields++;
+            any = false;
+        }
+    }
+    return fields + any;
+}
+
+size_t countFieldsByDelims( const std::string& path ){
+    gtools::StackReader rdr( path.c_str(), 256, BUFFER_SIZE );
+    size_t fields = 0;
+    std::string field;
+    while( rdr.getStringUntilDelim( field, ",\n" ) ){
+        rdr.getChar();
+        field.clear();
+        fields++;
+    }
+    return fields;
+}
+
+size_t countFieldsCsv( const std::string& path ){
+    gtools::StackReader rdr( path.c_str(), 256, BUFFER_SIZE );
+    gtools::CsvReader csv( rdr );
+    size_t fields = 0;
+    while( csv.nextRecord() )
+        fields += csv.size();
+    return fields;
+}
+
+int main(){
+    char path[] = "/tmp/csv_bench_XXXXXX";
+    int fd = mkstemp( path );
+    FILE* file = ( fd >= 0 ? fdopen( fd, "wb" ) : nullptr );
+    if( !file )
+        return 1;
+
+    // Mostly plain fields, some quoted - quotes hold no delimiters, so that
+    // getStringUntilDelim() splits the same.
+    for( size_t i = 0; i < RECORD_COUNT; i++ )
+        std::fprintf( file, "%zu,2023-10-11T12:%02d:%02d,user%d,\"GET /api/v1/items\",%d,%d.%02d,"
+                            "\"Mozilla/5.0 (X11; Linux x86_64)\",%s\n",
+                      i, (int)(i / 60 % 60), (int)(i % 60), rand() % 1000, 200 + rand() % 5 * 100,
+                      rand() % 1000, rand() % 100, ( i % 3 ? "ok" : "\"retry\"" ) );
+    std::fclose( file );
+
+    using namespace gtools;
+    std::string filePath = path;
+    size_t counts[3] = { 0, 0, 0 };
+
+    std::cout<< "\n"<< RECORD_COUNT <<" records, byte by byte:\nExecution took " <<
+    functionExecTimeReturnCallback( countFieldsByChars, ITERATIONS, [&](size_t cnt){
+        counts[0] = cnt; }, CALLBACK_ONLY_AT_THE_END, filePath ).count()
+    << " s\n";
+
+    std::cout<< "\n"<< RECORD_COUNT <<" records, getStringUntilDelim (no quotes):\nExecution took " <<
+    functionExecTimeReturnCallback( countFieldsByDelims, ITERATIONS, [&](size_t cnt){
+        counts[1] = cnt; }, CALLBACK_ONLY_AT_THE_END, filePath ).count()
+    << " s\n";
+
+    std::cout<< "\n"<< RECORD_COUNT <<" records, CsvReader:\nExecution took " <<
+    functionExecTimeReturnCallback( countFieldsCsv, ITERATIONS, [&](size_t cnt){
+        counts[2] = cnt; }, CALLBACK_ONLY_AT_THE_END, filePath ).count()
+    << " s\n";
+
+    std::cout<< "\nField counts: "<< counts[0] <<" / "<< counts[1] <<" / "<< counts[2] <<"\n";
+
+    std::remove( path );
+    return 0;
+}
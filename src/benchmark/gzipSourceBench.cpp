@@ -0,0 +1,84 @@
+#include <iostream>
+#include <string>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <zlib.h>
+#include <gryltools/stackreader.hpp>
+#include <gryltools/gzipsource.hpp>
+#include <gryltools/execution_time.hpp>
+
+/*! Counts the lines of a log - uncompressed, and gzipped read through the
+ *  GzipSource, inflating on the reading thread and on the helper one.
+ */
+
+const size_t LINE_COUNT = 1000000;
+const size_t ITERATIONS = 3;
+const size_t BUFFER_SIZE = 256 * 1024;
+
+size_t countLines( gtools::StackReader& rdr ){
+    size_t lines = 0;
+    while( rdr.skipUntilChar( '\n' ) ){
+        rdr.getChar();
+        lines++;
+    }
+    return lines;
+}
+
+size_t countLinesPlain( const std::string& path ){
+    gtools::StackReader rdr( path.c_str(), 256, BUFFER_SIZE );
+    return countLines( rdr );
+}
+
+size_t countLinesGzip( const std::string& path, bool threaded ){
+    gtools::GzipSource src( path.c_str(), threaded );
+    gtools::StackReader rdr( src, 256, BUFFER_SIZE );
+    return countLines( rdr );
+}
+
+int main(){
+    char plainPath[] = "/tmp/gzip_bench_XXXXXX";
+    int fd = mkstemp( plainPath );
+    if( fd < 0 )
+        return 1;
+    std::string gzPath = std::string( plainPath ) + ".gz";
+
+    FILE* plain = fdopen( fd, "wb" );
+    gzFile gz = gzopen( gzPath.c_str(), "wb6" );
+    if( !plain || !gz )
+        return 1;
+    char line[ 256 ];
+    for( size_t i = 0; i < LINE_COUNT; i++ ){
+        int len = std::snprintf( line, sizeof( line ),
+                                 "2023-10-11 12:%02d:%02d INFO request %zu served in %d ms\n",
+                                 (int)(i / 60 % 60), (int)(i % 60), i, rand() % 500 );
+        std::fwrite( line, 1, (size_t)len, plain );
+        gzwrite( gz, line, (unsigned)len );
+    }
+    std::fclose( plain );
+    gzclose( gz );
+
+    using namespace gtools;
+    size_t counts[3] = { 0, 0, 0 };
+
+    std::cout<< "\n"<< LINE_COUNT <<" lines, uncompressed:\nExecution took " <<
+    functionExecTimeReturnCallback( countLinesPlain, ITERATIONS, [&](size_t cnt){
+        counts[0] = cnt; }, CALLBACK_ONLY_AT_THE_END, plainPath ).count()
+    << " s\n";
+
+    std::cout<< "\n"<< LINE_COUNT <<" lines, gzip, inflating on reader's thread:\nExecution took " <<
+    functionExecTimeReturnCallback( countLinesGzip, ITERATIONS, [&](size_t cnt){
+        counts[1] = cnt; }, CALLBACK_ONLY_AT_THE_END, gzPath, false ).count()
+    << " s\n";
+
+    std::cout<< "\n"<< LINE_COUNT <<" lines, gzip, inflating on helper thread:\nExecution took " <<
+    functionExecTimeReturnCallback( countLinesGzip, ITERATIONS, [&](size_t cnt){
+        counts[2] = cnt; }, CALLBACK_ONLY_AT_THE_END, gzPath, true ).count()
+    << " s\n";
+
+    std::cout<< "\nLine counts: "<< counts[0] <<" / "<< counts[1] <<" / "<< counts[2] <<"\n";
+
+    std::remove( plainPath );
+    std::remove( gzPath.c_str() );
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <gryltools/lexer.hpp>
+#include <gryltools/execution_time.hpp>
+#include "benchGrammarTables.hpp"
+
+/*! Compares the lexer running on tables generated ahead of time by dfagen,
+ *  with the lexer running on the automaton built at runtime from the same
+ *  grammar.
+ */
+
+const size_t SAMPLE_REPEATS = 2000;
+const size_t ITERATIONS = 10;
+const size_t BUILD_ITERATIONS = 20;
+const size_t SMALL_INPUTS = 200;
+
+const char* sourceSample =
+    "/* Finds the value. */\n"
+    "int find( const char* str, int len ){\n"
+    "    for( int i = 0; i < len; i++ ){\n"
+    "        if( str[i] == 'x' || str[i] == '\\n' )\n"
+    "            return i * 0x1F + 3.25e-2; // hit\n"
+    "    }\n"
+    "    return printf( \"not found: \\\"%s\\\"\\n\", str );\n"
+    "}\n";
+
+bool buildRuntimeAutomaton( gtools::DfaBuilder& builder ){
+    for( int32_t i = 0; i < (int32_t)( sizeof( benchlexer::tokenRegexes ) / sizeof( const char* ) ); i++ ){
+        if( !builder.addRule( i, benchlexer::tokenRegexes[i] ) )
+            return false;
+    }
+    return builder.build();
+}
+
+size_t countTokens( const std::string& str, const gtools::DfaTables& tables ){
+    std::istringstream iss( str, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 256, 4096 );
+    gtools::Lexer lexer( rdr, tables );
+    gtools::Token tok;
+    size_t count = 0;
+
+    while( lexer.getNextToken( tok ) )
+        count += tok.id + 1;
+    return count;
+}
+
+// Program start - the automaton is built before the first input.
+size_t runtimeColdStart( const std::string& str ){
+    gtools::DfaBuilder builder;
+    buildRuntimeAutomaton( builder );
+    return countTokens( str, builder.getTables() );
+}
+
+size_t generatedColdStart( const std::string& str ){
+    return countTokens( str, benchlexer::tables );
+}
+
+size_t buildOnly(){
+    gtools::DfaBuilder builder;
+    buildRuntimeAutomaton( builder );
+    return builder.getStateCount();
+}
+
+int main(){
+    gtools::DfaBuilder builder;
+    if( !buildRuntimeAutomaton( builder ) ){
+        std::cout<< "Grammar error: "<< builder.getLastError() <<"\n";
+        return 1;
+    }
+
+    std::string sample;
+    for( size_t i = 0; i < SAMPLE_REPEATS; i++ )
+        sample += sourceSample;
+
+    using namespace gtools;
+    size_t runtimeCount = 0, generatedCount = 0;
+
+    std::cout<< "Grammar: "<< benchlexer::tables.stateCount <<" states, "
+             << benchlexer::tables.classCount <<" byte classes.\n";
+
+    std::cout<< "\nBuilding the automaton at runtime:\nExecution took " <<
+    ( functionExecTimeRepeated( buildOnly, BUILD_ITERATIONS ).count() / BUILD_ITERATIONS )
+    << " s per build\n";
+
+    std::cout<< "\nLexing "<< sample.size() <<" bytes with runtime-built tables:\nExecution took " <<
+    functionExecTimeReturnCallback( countTokens, ITERATIONS, [&](size_t cnt){
+        runtimeCount = cnt; }, CALLBACK_ONLY_AT_THE_END, sample, builder.getTables() ).count()
+    << " s\n";
+
+    std::cout<< "\nLexing "<< sample.size() <<" bytes with generated tables:\nExecution took " <<
+    functionExecTimeReturnCallback( countTokens, ITERATIONS, [&](size_t cnt){
+        generatedCount = cnt; }, CALLBACK_ONLY_AT_THE_END, sample, benchlexer::tables ).count()
+    << " s\n";
+
+    std::cout<< "\nToken checksums: "<< runtimeCount <<" / "<< generatedCount <<"\n";
+
+    // Many short runs, as by a command-line tool - here the build dominates.
+    std::string small( sourceSample );
+
+    std::cout<< "\n"<< SMALL_INPUTS <<" cold starts with runtime-built tables:\nExecution took " <<
+    functionExecTimeReturnCallback( runtimeColdStart, SMALL_INPUTS, [&](size_t cnt){
+        runtimeCount = cnt; }, CALLBACK_ONLY_AT_THE_END, small ).count()
+    << " s\n";
+
+    std::cout<< "\n"<< SMALL_INPUTS <<" cold starts with generated tables:\nExecution took " <<
+    functionExecTimeReturnCallback( generatedColdStart, SMALL_INPUTS, [&](size_t cnt){
+        generatedCount = cnt; }, CALLBACK_ONLY_AT_THE_END, small ).count()
+    << " s\n";
+
+    std::cout<< "\nToken checksums: "<< runtimeCount <<" / "<< generatedCount <<"\n";
+
+    return 0;
+}
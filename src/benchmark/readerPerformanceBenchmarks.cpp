@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
@@ -6,6 +8,8 @@
 #include <sstream>
 #include <string>
 #include <gryltools/stackreader.hpp>
+#include <gryltools/parallelscan.hpp>
+#include <gryltools/scantools.hpp>
 #include <gryltools/execution_time.hpp>
 
 const size_t SAMPLE_SIZE = 50001;
@@ -195,6 +199,180 @@ StreamStats readUsingStackReaderBUFF(std::istream& is, size_t buffSize){
     return StreamStats( lineCount, posInLine );
 }
 
+// Same as readCharByChar, but through the inlined iterator.
+StreamStats readUsingStackReaderIterator(std::istream& is){
+    is.clear();
+    is.seekg(0, is.beg);
+
+    size_t posInLine = 0;
+	size_t lineCount = 0;
+
+    gtools::StackReader reader( is, 1024, 2048 );
+
+    for( char c : reader ){
+        if( c == '\n' ){
+            posInLine = 0;
+            lineCount++;
+        }
+        else
+            posInLine++;
+    }
+
+    return StreamStats( lineCount, posInLine );
+}
+
+// Newlines counted by the STL algorithm over the reader's range.
+StreamStats countUsingStackReaderRange(std::istream& is){
+    is.clear();
+    is.seekg(0, is.beg);
+
+    gtools::StackReader reader( is, 1024, 2048 );
+
+    return StreamStats( std::count( reader.begin(), reader.end(), '\n' ), 0 );
+}
+
+// Reads line by line into the same string - no allocations once it has grown.
+StreamStats readLinesUsingStackReader(std::istream& is){
+    is.clear();
+    is.seekg(0, is.beg);
+
+	size_t lineCount = 0;
+    std::string line;
+
+    gtools::StackReader reader( is, 1024, 2048 );
+
+    while( reader.getStringUntilDelim( line, "\n" ) ){
+        if( reader.getChar() != '\n' )
+            break;
+        lineCount++;
+        line.clear();
+    }
+
+    return StreamStats( lineCount, line.size() );
+}
+
+// Skips the words, counting the position by the caller's counters.
+StreamStats skipWordsWithCounters(std::istream& is){
+    is.clear();
+    is.seekg(0, is.beg);
+
+    size_t lineCount = 0, posInLine = 0;
+    gtools::StackReader reader( is, 1024, 2048 );
+
+    while( reader.skipUntilDelim( " ", lineCount, posInLine ) ){
+        reader.getChar();
+        posInLine++;
+    }
+    return StreamStats( lineCount, posInLine );
+}
+
+// Same, with the position tracked by the reader, and asked for at the end.
+// Tracked column is 0-based, counters count it from the newline itself.
+StreamStats skipWordsWithTracking(std::istream& is){
+    is.clear();
+    is.seekg(0, is.beg);
+
+    gtools::StackReader reader( is, 1024, 2048 );
+    reader.setPositionTracking( true );
+
+    while( reader.skipUntilChar( ' ' ) )
+        reader.getChar();
+
+    gtools::StackReader::Position pos = reader.position();
+    return StreamStats( pos.line, pos.column );
+}
+
+// Macro-expansion-like load - a burst of large strings is put back in front
+// of the buffered stream, then everything is read.
+StreamStats readWithLargePutbacks(std::istream& is){
+    is.clear();
+    is.seekg(0, is.beg);
+
+    size_t lineCount = 0;
+    size_t expanded = 0;
+    const std::string expansion( 1024, 'x' );
+
+    gtools::StackReader reader( is, 1024, 2048 );
+
+    reader.skipUntilChar( '\n' );
+    for( size_t i = 0; i < 4000; i++ )
+        reader.putString( expansion );
+
+    char c;
+    while( reader.getChar( c ) ){
+        if( c == '\n' )
+            lineCount++;
+        else if( c == 'x' )
+            expanded++;
+    }
+
+    return StreamStats( lineCount, expanded / expansion.size() );
+}
+
+// Numeric log ingest - numbers copied out, and converted by strtod().
+StreamStats readNumbersUsingStrtod(std::istream& is){
+    is.clear();
+    is.seekg(0, is.beg);
+
+    size_t count = 0;
+    double sum = 0;
+    std::string number;
+    gtools::StackReader reader( is );
+
+    while( reader.skipWhitespace() ){
+        number.clear();
+        reader.getStringUntilDelim( number, " \n" );
+        sum += std::strtod( number.c_str(), nullptr );
+        count++;
+    }
+    return StreamStats( count, (size_t)sum );
+}
+
+// Same, parsed in place by the reader.
+StreamStats readNumbersUsingGetDouble(std::istream& is){
+    is.clear();
+    is.seekg(0, is.beg);
+
+    size_t count = 0;
+    double sum = 0, value;
+    gtools::StackReader reader( is );
+
+    while( reader.getDouble( value, gtools::StackReader::SKIPMODE_SKIPWS ) ){
+        sum += value;
+        count++;
+    }
+    return StreamStats( count, (size_t)sum );
+}
+
+// Counts lines of the file on all cores, scanning the chunks in place.
+StreamStats readUsingParallelScan(int fd){
+    std::vector< gtools::ScanChunk > chunks;
+    std::vector< char > results;
+
+    gtools::ParallelScan::scan< char >( fd, 
+        []( gtools::StackReader& rdr, gtools::ScanChunk& chunk, char& ){
+            gtools::StackReader::View view;
+            const char* lastNewline = nullptr;
+
+            while( rdr.isReadable() && rdr.getView( view, rdr.currentLength() ) )
+                chunk.endlines += gtools::ScanTools::countNewlines( view.begin(), 
+                                                                    view.end(), lastNewline );
+        }, chunks, results );
+
+    if( chunks.empty() )
+        return StreamStats();
+    return StreamStats( chunks.back().firstLine + chunks.back().endlines, 0 );
+}
+
+// Lines of a timestamp, a measurement and a counter.
+void generateNumericSample( std::string& str, size_t sampleSize ){
+    char line[ 128 ];
+    while( str.size() < sampleSize ){
+        int len = std::snprintf( line, sizeof( line ), "%d.%06d %.4f %d\n", 1697040000 + rand() % 100000,
+                                 rand() % 1000000, ( rand() % 2000000 ) / 7.0 - 1000, rand() % 100000 );
+        str.append( line, len );
+    }
+}
 
 void generateSample( std::string& str, size_t sampleSize, size_t maxLineSize = 80 ){
     size_t nextLinePos = 0 + (rand() % maxLineSize);
@@ -247,6 +425,61 @@ int main(){
     functionExecTimeReturnCallback( readUsingStackReaderBUFF, ITERATIONS, [](StreamStats&& st){
         std::cout<< st <<"\n"; }, CALLBACK_ONLY_AT_THE_END, sstr, BUFFSIZE ).count()
     << " ms\n"; 
+
+    std::cout<< "\n\nstackReaderIterator:\n" <<
+    functionExecTimeReturnCallback( readUsingStackReaderIterator, ITERATIONS, [](StreamStats&& st){
+        std::cout<< st <<"\n"; }, CALLBACK_ONLY_AT_THE_END, sstr ).count()
+    << " ms\n"; 
+
+    std::cout<< "\n\nstackReaderRange (std::count):\n" <<
+    functionExecTimeReturnCallback( countUsingStackReaderRange, ITERATIONS, [](StreamStats&& st){
+        std::cout<< st <<"\n"; }, CALLBACK_ONLY_AT_THE_END, sstr ).count()
+    << " ms\n"; 
+
+    std::cout<< "\n\nstackReaderLines:\n" <<
+    functionExecTimeReturnCallback( readLinesUsingStackReader, ITERATIONS, [](StreamStats&& st){
+        std::cout<< st <<"\n"; }, CALLBACK_ONLY_AT_THE_END, sstr ).count()
+    << " ms\n"; 
+
+    std::cout<< "\n\nskipWordsCounters:\n" <<
+    functionExecTimeReturnCallback( skipWordsWithCounters, ITERATIONS, [](StreamStats&& st){
+        std::cout<< st <<"\n"; }, CALLBACK_ONLY_AT_THE_END, sstr ).count()
+    << " ms\n"; 
+
+    std::cout<< "\n\nskipWordsTracking:\n" <<
+    functionExecTimeReturnCallback( skipWordsWithTracking, ITERATIONS, [](StreamStats&& st){
+        std::cout<< st <<"\n"; }, CALLBACK_ONLY_AT_THE_END, sstr ).count()
+    << " ms\n"; 
+
+    std::cout<< "\n\nstackReaderPutbacks:\n" <<
+    functionExecTimeReturnCallback( readWithLargePutbacks, ITERATIONS / 1000, [](StreamStats&& st){
+        std::cout<< st <<"\n"; }, CALLBACK_ONLY_AT_THE_END, sstr ).count()
+    << " ms\n"; 
+
+    std::string numericSample;
+    generateNumericSample( numericSample, SAMPLE_SIZE );
+    std::istringstream nstr( numericSample, std::ios_base::in | std::ios_base::binary );
+
+    std::cout<< "\n\nnumbersStrtod:\n" <<
+    functionExecTimeReturnCallback( readNumbersUsingStrtod, ITERATIONS / 10, [](StreamStats&& st){
+        std::cout<< st <<"\n"; }, CALLBACK_ONLY_AT_THE_END, nstr ).count()
+    << " ms\n"; 
+
+    std::cout<< "\n\nnumbersGetDouble:\n" <<
+    functionExecTimeReturnCallback( readNumbersUsingGetDouble, ITERATIONS / 10, [](StreamStats&& st){
+        std::cout<< st <<"\n"; }, CALLBACK_ONLY_AT_THE_END, nstr ).count()
+    << " ms\n"; 
+
+    FILE* sampleFile = std::tmpfile();
+    std::fwrite( sample.c_str(), 1, sample.size(), sampleFile );
+    std::fflush( sampleFile );
+
+    std::cout<< "\n\nparallelScan ("<< ParallelScan::getDefaultThreadCount() <<" threads):\n" <<
+    functionExecTimeReturnCallback( readUsingParallelScan, ITERATIONS, [](StreamStats&& st){
+        std::cout<< st <<"\n"; }, CALLBACK_ONLY_AT_THE_END, fileno( sampleFile ) ).count()
+    << " ms\n"; 
+
+    std::fclose( sampleFile );
     
     return 0;
 }
@@ -1,29 +1,44 @@
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <regex>
+#include <gryltools/lexer.hpp>
+#include <gryltools/execution_time.hpp>
 
-struct Token{
-    size_t id;
-    std::string data;
-};
+const size_t SAMPLE_REPEATS = 2000;
+const size_t ITERATIONS = 10;
 
-/*class Tokenizer{
-private:
-    char* buf
+// Counts tokens by the regex alternation, finding the matched group.
+size_t countRegexTokens( const std::string& str, const std::regex& r ){
+    const char* bufBeg = str.c_str();
+    const char* bufEnd = bufBeg + str.size();
+    std::cmatch m;
+    size_t count = 0;
 
-public:
-void getNextToken_Priv( const char* buf, size_t len, Token& tok ){
+    while( std::regex_search( bufBeg, bufEnd, m, r ) ){
+        size_t group = 1;
+        while( group < m.size() && !m[ group ].matched )
+            group++;
 
+        count += group;
+        bufBeg += m.position() + m.length();
+    }
+    return count;
 }
 
-void fetchToBuffer( std::istream& is, char* buf, size_t len ){
-
+// Counts tokens by the lexer's DFA.
+size_t countLexerTokens( const std::string& str, const gtools::DfaTables& tables ){
+    std::istringstream iss( str, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 256, 4096 );
+    gtools::Lexer lexer( rdr, tables );
+    gtools::Token tok;
+    size_t count = 0;
+
+    while( lexer.getNextToken( tok ) )
+        count += tok.id + 1;
+    return count;
 }
 
-void getNextToken( std::istream& is, 
-
-};*/
-
 int main ()
 {
     std::string reg = R"((\b[[:alpha:]]+\b)|(\b\d+\b)|(\s+)|(.))";
@@ -68,6 +83,33 @@ int main ()
         bufBeg += m.position() + m.length();
     } 
 
+    // Same tokens by the DFA lexer. Longest match makes the \b unnecessary.
+    gtools::DfaBuilder builder;
+    builder.addRule( 0, "[[:alpha:]]+" );
+    builder.addRule( 1, "\\d+" );
+    builder.addRule( 2, "\\s+" );
+    builder.addRule( 3, "." );
+    builder.build();
+
+    std::string sample;
+    for( size_t i = 0; i < SAMPLE_REPEATS; i++ )
+        sample += str + " " + std::to_string( i ) + ";";
+
+    using namespace gtools;
+    size_t regexCount = 0, lexerCount = 0;
+
+    std::cout<< "\n\nstd::regex_search on "<< sample.size() <<" bytes:\nExecution took " <<
+    functionExecTimeReturnCallback( countRegexTokens, ITERATIONS, [&](size_t cnt){
+        regexCount = cnt; }, CALLBACK_ONLY_AT_THE_END, sample, r ).count()
+    << " s\n";
+
+    std::cout<< "\nDFA lexer ("<< builder.getStateCount() <<" states):\nExecution took " <<
+    functionExecTimeReturnCallback( countLexerTokens, ITERATIONS, [&](size_t cnt){
+        lexerCount = cnt; }, CALLBACK_ONLY_AT_THE_END, sample, builder.getTables() ).count()
+    << " s\n";
+
+    std::cout<< "\nToken checksums: "<< regexCount <<" / "<< lexerCount <<"\n";
+
     return 0;
 }
 
@@ -1,3 +1,6 @@
+#ifndef BLOCKINGQUEUE_HPP_INCLUDED
+#define BLOCKINGQUEUE_HPP_INCLUDED
+
 #include <mutex>
 #include <condition_variable>
 #include <deque>
@@ -54,3 +57,5 @@ public:
 };
 
 }
+
+#endif // BLOCKINGQUEUE_HPP_INCLUDED
@@ -0,0 +1,155 @@
+#include "bytesource.hpp"
+#include <cstring>
+#include <algorithm>
+
+#if defined _GRYLTOOL_POSIX
+    #include <unistd.h>
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+namespace gtools{
+
+long IStreamSource::read( char* buff, size_t len )
+{
+    std::streambuf* sbuf = iStream.rdbuf();
+    if( !sbuf )
+        return 0;
+    return (long)sbuf->sgetn( buff, len );
+}
+
+CFileSource::~CFileSource()
+{
+    if( ownsFile && cStream )
+        fclose( cStream );
+}
+
+long CFileSource::read( char* buff, size_t len )
+{
+    // Reader is the only user of the file, so the stdio locking is skipped.
+#if defined __GLIBC__ && defined _GNU_SOURCE
+    return (long)fread_unlocked( buff, 1, len, cStream );
+#else
+    return (long)fread( buff, 1, len, cStream );
+#endif
+}
+
+long MemorySource::read( char* buff, size_t len )
+{
+    if( pos + len > size )
+        len = size - pos;
+
+    std::memcpy( buff, data + pos, len );
+    pos += len;
+    return (long)len;
+}
+
+bool MemorySource::getRegion( const char*& regData, size_t& regLen )
+{
+    if( pos >= size )
+        return false;
+
+    regData = data + pos;
+    regLen = size - pos;
+    pos = size;
+    return true;
+}
+
+#if defined _GRYLTOOL_POSIX
+
+FdSource::~FdSource()
+{
+    if( ownsFd )
+        close( fileDesc );
+}
+
+long FdSource::read( char* buff, size_t len )
+{
+    if( usePread && endOffset >= 0 && offset + (off_t)len > endOffset )
+        len = ( endOffset > offset ? endOffset - offset : 0 );
+    if( !len )
+        return 0;
+
+    long red;
+    do{
+        red = ( usePread ? ::pread( fileDesc, buff, len, offset ) 
+                         : ::read( fileDesc, buff, len ) );
+    } while( red < 0 && errno == EINTR );
+
+    if( red < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) )
+        return READ_WOULD_BLOCK;
+    if( usePread && red > 0 )
+        offset += red;
+    return red;
+}
+
+bool FdSource::isPrefetchable() const
+{
+    int flags = fcntl( fileDesc, F_GETFL );
+    return flags >= 0 && !( flags & O_NONBLOCK );
+}
+
+/*! Maps the whole file pointed by 'fd'. Mapping stays valid after the 
+ *  descriptor is closed - unless 'atOffset', then it must outlive the source.
+ */ 
+MappedFileSource::MappedFileSource( int fd, bool atOffset )
+    : MemorySource( nullptr, 0 )
+{
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode ) )
+        return;
+
+    // Empty files can't be mapped, but there's nothing to read anyway.
+    if( st.st_size == 0 ){
+        mapped = true;
+        return;
+    }
+
+    void* mem = mmap( nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    if( mem == MAP_FAILED )
+        return;
+    madvise( mem, (size_t)st.st_size, MADV_SEQUENTIAL );
+
+    data = (const char*)mem;
+    size = (size_t)st.st_size;
+    mapped = true;
+
+    if( atOffset ){
+        off_t current = lseek( fd, 0, SEEK_CUR );
+        if( current > 0 )
+            pos = std::min( (size_t)current, size );
+        offsetFd = fd;
+    }
+}
+
+void MappedFileSource::advanceFd()
+{
+    if( offsetFd >= 0 )
+        lseek( offsetFd, (off_t)pos, SEEK_SET );
+}
+
+long MappedFileSource::read( char* buff, size_t len )
+{
+    long red = MemorySource::read( buff, len );
+    advanceFd();
+    return red;
+}
+
+bool MappedFileSource::getRegion( const char*& regData, size_t& regLen )
+{
+    bool got = MemorySource::getRegion( regData, regLen );
+    advanceFd();
+    return got;
+}
+
+MappedFileSource::~MappedFileSource()
+{
+    if( data )
+        munmap( (void*)data, size );
+}
+
+#endif // _GRYLTOOL_POSIX
+
+}
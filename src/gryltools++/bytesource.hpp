@@ -0,0 +1,159 @@
+#ifndef BYTESOURCE_HPP_INCLUDED
+#define BYTESOURCE_HPP_INCLUDED
+
+#include <istream>
+#include <cstdio>
+#include <functional>
+#include "systemcheck.h"
+
+#if defined _GRYLTOOL_POSIX
+    #include <sys/types.h>
+#endif
+
+/*! Byte sources - the inputs of the StackReader.
+ *  - Copying sources just implement read().
+ *  - Direct (zero-copy) sources also expose their memory by getRegion(), and
+ *    reader then scans it in place, without copying to the stack buffer.
+ */ 
+
+namespace gtools{
+
+class ByteSource{
+public:
+    // Non-blocking source has no data yet - it's not the end.
+    const static long READ_WOULD_BLOCK = -2;
+
+    virtual ~ByteSource() {}
+
+    /*! Reads up to 'len' bytes to 'buff'.
+     *  @return count of bytes read, 0 at the end of source, READ_WOULD_BLOCK
+     *          if non-blocking source has nothing yet, other negative on error.
+     */ 
+    virtual long read( char* buff, size_t len ) = 0;
+
+    /*! Gets the next region of a direct source. Region stays valid as long 
+     *  as the source lives.
+     *  @return false if no more regions, or source is not direct.
+     */ 
+    virtual bool getRegion( const char*& data, size_t& len ) { return false; }
+
+    virtual bool isDirect() const { return false; }
+
+    // Source may be read on the reader's prefetch thread.
+    virtual bool isPrefetchable() const { return true; }
+};
+
+/*! Reads the std::istream through it's streambuf, bypassing the sentry.
+ *  Stream's state flags are not updated.
+ */ 
+class IStreamSource : public ByteSource{
+private:
+    std::istream& iStream;
+
+public:
+    IStreamSource( std::istream& is ) : iStream( is ) {}
+    long read( char* buff, size_t len ) override;
+};
+
+class CFileSource : public ByteSource{
+private:
+    FILE* cStream;
+    bool ownsFile;
+
+public:
+    CFileSource( FILE* file, bool ownsFile = false ) : cStream( file ), ownsFile( ownsFile ) {}
+    ~CFileSource();
+    long read( char* buff, size_t len ) override;
+};
+
+/*! Plugs any reading function in, without subclassing.
+ */ 
+class CallbackSource : public ByteSource{
+private:
+    std::function< long(char*, size_t) > readCallback;
+
+public:
+    CallbackSource( std::function< long(char*, size_t) > cbk ) : readCallback( cbk ) {}
+    long read( char* buff, size_t len ) override {
+        return readCallback( buff, len );
+    }
+};
+
+/*! In-memory span, scanned in place. Memory is not copied, so it must 
+ *  outlive the source.
+ */ 
+class MemorySource : public ByteSource{
+protected:
+    const char* data;
+    size_t size;
+    size_t pos = 0;
+
+public:
+    MemorySource( const char* data, size_t size ) : data( data ), size( size ) {}
+
+    long read( char* buff, size_t len ) override;
+    bool getRegion( const char*& data, size_t& len ) override;
+    bool isDirect() const override { return true; }
+
+    const char* getData() const { return data; }
+    size_t getSize() const { return size; }
+};
+
+#if defined _GRYLTOOL_POSIX
+
+/*! Raw file descriptor, read by read(), or by pread() if reading from own
+ *  offset - then several sources can read the same descriptor concurrently.
+ *  Non-blocking descriptor (e.g. pipe) gives READ_WOULD_BLOCK if empty.
+ */ 
+class FdSource : public ByteSource{
+private:
+    int fileDesc;
+    bool ownsFd;
+    bool usePread = false;
+    off_t offset = 0;
+    off_t endOffset = -1;
+
+public:
+    FdSource( int fd, bool ownsFd = false ) : fileDesc( fd ), ownsFd( ownsFd ) {}
+
+    // Reads range [offset, offset+length). If length is negative, until the end.
+    FdSource( int fd, off_t offset, off_t length, bool ownsFd = false ) 
+        : fileDesc( fd ), ownsFd( ownsFd ), usePread( true ), offset( offset ),
+          endOffset( length < 0 ? -1 : offset + length ) {}
+
+    ~FdSource();
+    long read( char* buff, size_t len ) override;
+
+    // Non-blocking descriptor is not prefetched - prefetcher would take
+    // READ_WOULD_BLOCK for the end.
+    bool isPrefetchable() const override;
+};
+
+/*! Whole file mapped to memory.
+ *  - If 'atOffset', reading starts at the descriptor's current offset, and
+ *    the descriptor is advanced past the bytes given out, as if they were
+ *    read from it - same as the FdSource would do.
+ */ 
+class MappedFileSource : public MemorySource{
+private:
+    bool mapped = false;
+    int offsetFd = -1;
+
+    void advanceFd();
+
+public:
+    MappedFileSource( int fd, bool atOffset = false );
+    ~MappedFileSource();
+
+    long read( char* buff, size_t len ) override;
+    bool getRegion( const char*& data, size_t& len ) override;
+
+    // False if file couldn't be mapped (e.g. it's not a regular file).
+    bool isMapped() const { return mapped; }
+};
+
+#endif // _GRYLTOOL_POSIX
+
+}
+
+#endif // BYTESOURCE_HPP_INCLUDED
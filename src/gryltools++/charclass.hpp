@@ -0,0 +1,139 @@
+#ifndef CHARCLASS_HPP_INCLUDED
+#define CHARCLASS_HPP_INCLUDED
+
+#include <cstddef>
+#include <string>
+
+/*! Character classes for the delimiter scanning.
+ *  - CharSet is a 256-bit bitmap, usable both at runtime and as constexpr.
+ *  - CharClass, CharRange and CharUnion are compile-time classes, to be used
+ *    as predicates, e.g. StackReader::skipUntil( CharClass<'\n', ';'>(), ... ).
+ */ 
+
+namespace gtools{
+
+class CharSet{
+private:
+    unsigned long long bits[4];
+
+public:
+    constexpr CharSet() : bits{ 0, 0, 0, 0 } {}
+    explicit constexpr CharSet( char c ) : bits{ 0, 0, 0, 0 } { add( c ); }
+
+    explicit CharSet( const char* chars, size_t len ) : bits{ 0, 0, 0, 0 } {
+        for( size_t i = 0; i < len; i++ )
+            add( chars[i] );
+    }
+
+    explicit CharSet( const std::string& chars ) : CharSet( chars.c_str(), chars.size() ) {}
+
+    constexpr CharSet& add( char c ){
+        unsigned char u = (unsigned char)c;
+        bits[ u >> 6 ] |= 1ull << (u & 63);
+        return *this;
+    }
+
+    constexpr CharSet& addRange( char from, char to ){
+        for( unsigned u = (unsigned char)from; u <= (unsigned char)to; u++ )
+            bits[ u >> 6 ] |= 1ull << (u & 63);
+        return *this;
+    }
+
+    constexpr CharSet& add( const CharSet& other ){
+        for( int i = 0; i < 4; i++ )
+            bits[i] |= other.bits[i];
+        return *this;
+    }
+
+    // Set of all the characters not in this set.
+    constexpr CharSet inverted() const {
+        CharSet inv;
+        for( int i = 0; i < 4; i++ )
+            inv.bits[i] = ~bits[i];
+        return inv;
+    }
+
+    constexpr bool contains( char c ) const {
+        return (bits[ (unsigned char)c >> 6 ] >> ((unsigned char)c & 63)) & 1;
+    }
+
+    constexpr bool operator()( char c ) const {
+        return contains( c );
+    }
+
+    // Count of characters in the set.
+    size_t size() const {
+        return __builtin_popcountll( bits[0] ) + __builtin_popcountll( bits[1] ) +
+               __builtin_popcountll( bits[2] ) + __builtin_popcountll( bits[3] );
+    }
+
+    // Writes up to 'maxCount' members to 'chars'. Returns count written.
+    size_t getMembers( char* chars, size_t maxCount ) const {
+        size_t cnt = 0;
+        for( unsigned w = 0; w < 4; w++ ){
+            for( unsigned long long b = bits[w]; b && cnt < maxCount; b &= b - 1 )
+                chars[ cnt++ ] = (char)( w * 64 + __builtin_ctzll( b ) );
+        }
+        return cnt;
+    }
+};
+
+/*! Tag for the compile-time classes, so that scanners can use their bitmaps.
+ */ 
+struct CharClassTag {};
+
+template <char... Chars>
+struct CharClass : CharClassTag {
+    static constexpr CharSet makeSet(){
+        CharSet set;
+        const char chars[] = { Chars..., '\0' };
+        for( size_t i = 0; i < sizeof...(Chars); i++ )
+            set.add( chars[i] );
+        return set;
+    }
+
+    static constexpr CharSet set = makeSet();
+
+    constexpr bool operator()( char c ) const {
+        return set.contains( c );
+    }
+};
+
+template <char From, char To>
+struct CharRange : CharClassTag {
+    static constexpr CharSet set = CharSet().addRange( From, To );
+
+    constexpr bool operator()( char c ) const {
+        return set.contains( c );
+    }
+};
+
+template <typename... Classes>
+struct CharUnion : CharClassTag {
+    static constexpr CharSet makeSet(){
+        CharSet set;
+        const CharSet sets[] = { Classes::set..., CharSet() };
+        for( size_t i = 0; i < sizeof...(Classes); i++ )
+            set.add( sets[i] );
+        return set;
+    }
+
+    static constexpr CharSet set = makeSet();
+
+    constexpr bool operator()( char c ) const {
+        return set.contains( c );
+    }
+};
+
+template <char... Chars>
+constexpr CharSet CharClass< Chars... >::set;
+
+template <char From, char To>
+constexpr CharSet CharRange< From, To >::set;
+
+template <typename... Classes>
+constexpr CharSet CharUnion< Classes... >::set;
+
+}
+
+#endif // CHARCLASS_HPP_INCLUDED
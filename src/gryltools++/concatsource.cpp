@@ -0,0 +1,179 @@
+#include "concatsource.hpp"
+#include <algorithm>
+#include <cstring>
+
+#if defined _GRYLTOOL_POSIX
+    #include <fcntl.h>
+#endif
+
+namespace gtools{
+
+ConcatSource::ConcatSource( const std::vector< std::string >& filePaths,
+                            size_t lookahead, size_t headSz )
+    : paths( filePaths ), sourceCount( filePaths.size() ), headSize( headSz ? headSz : 1 )
+{
+    if( !sourceCount )
+        return;
+
+    // One more slot is held by the reading thread.
+    for( size_t i = 0; i < std::max( lookahead, (size_t)1 ) + 1; i++ )
+        freeSlots.push( PreparedSource{ 0, nullptr, std::unique_ptr< char[] >( new char[ headSize ] ),
+                                        0, false } );
+
+    openerThread = std::thread( &ConcatSource::openerLoop, this );
+}
+
+ConcatSource::ConcatSource( std::vector< std::unique_ptr< ByteSource > > srcs )
+    : sources( std::move( srcs ) ), sourceCount( sources.size() )
+{}
+
+ConcatSource::~ConcatSource()
+{
+    // Wake the opener if it's waiting for a free slot, and wait for it.
+    if( openerThread.joinable() ){
+        freeSlots.push( PreparedSource{ 0, nullptr, nullptr, 0, false } );
+        openerThread.join();
+    }
+}
+
+/*! Opener thread's loop. Opens the files in order, and reads their heads,
+ *  until all are prepared, or a slot without head is received (stop signal).
+ */
+void ConcatSource::openerLoop()
+{
+    for( size_t i = 0; i < sourceCount; i++ ){
+        PreparedSource slot = freeSlots.pop();
+        if( !slot.head )
+            break;
+
+        slot.index = i;
+        slot.headLen = 0;
+        slot.failed = false;
+
+        std::unique_ptr< ByteSource > src;
+    #if defined _GRYLTOOL_POSIX
+        int fd = open( paths[i].c_str(), O_RDONLY );
+        if( fd >= 0 )
+            src.reset( new FdSource( fd, true ) );
+    #else
+        FILE* file = std::fopen( paths[i].c_str(), "rb" );
+        if( file )
+            src.reset( new CFileSource( file, true ) );
+    #endif
+
+        if( src ){
+            long red;
+            while( slot.headLen < headSize &&
+                   ( red = src->read( slot.head.get() + slot.headLen, headSize - slot.headLen ) ) > 0 )
+                slot.headLen += (size_t)red;
+
+            // File read whole is closed right away.
+            if( slot.headLen == headSize )
+                slot.source = std::move( src );
+        }
+        else
+            slot.failed = true;
+
+        preparedSlots.push( std::move( slot ) );
+    }
+}
+
+/*! Switches to the next source. Slot of the finished file is given back
+ *  to the opener.
+ *  @return false if there are no more sources.
+ */
+bool ConcatSource::nextSource()
+{
+    current.source.reset();
+    if( nextIndex >= sourceCount )
+        return false;
+
+    if( !paths.empty() ){
+        if( current.head )
+            freeSlots.push( std::move( current ) );
+
+        current = preparedSlots.pop();
+        if( current.failed )
+            ++failedCount;
+    }
+    else{
+        current.source = std::move( sources[ nextIndex ] );
+        current.index = nextIndex;
+    }
+
+    headPos = 0;
+    localOffset = 0;
+    sourceStarts.push_back( bytesRead );
+    ++nextIndex;
+    return true;
+}
+
+long ConcatSource::read( char* buff, size_t len )
+{
+    if( !len )
+        return 0;
+
+    while(1){
+        long red = 0;
+        if( headPos < current.headLen ){
+            red = (long)std::min( len, current.headLen - headPos );
+            std::memcpy( buff, current.head.get() + headPos, (size_t)red );
+            headPos += (size_t)red;
+        }
+        else if( current.source )
+            red = current.source->read( buff, len );
+
+        if( red > 0 ){
+            bytesRead += (uint64_t)red;
+            localOffset += (uint64_t)red;
+            return red;
+        }
+        if( red < 0 )
+            return red;
+
+        if( !nextSource() )
+            return 0;
+    }
+}
+
+size_t ConcatSource::getCurrentIndex() const {
+    return ( sourceStarts.empty() ? 0 : nextIndex - 1 );
+}
+
+bool ConcatSource::locate( uint64_t offset, size_t& index, uint64_t& offsetInSource ) const
+{
+    if( sourceStarts.empty() || offset > bytesRead )
+        return false;
+
+    // Last source starting at or before the offset - empty ones are passed.
+    size_t i = (size_t)( std::upper_bound( sourceStarts.begin(), sourceStarts.end(), offset )
+                         - sourceStarts.begin() ) - 1;
+    index = i;
+    offsetInSource = offset - sourceStarts[i];
+    return true;
+}
+
+ConcatReader::ConcatReader( const std::vector< std::string >& filePaths,
+                            size_t prioritySize, size_t bufferSize, size_t lookahead )
+    : ConcatStorage( filePaths, lookahead ),
+      StackReader( concatSource, prioritySize, bufferSize )
+{}
+
+ConcatReader::ConcatReader( std::vector< std::unique_ptr< ByteSource > > sources,
+                            size_t prioritySize, size_t bufferSize )
+    : ConcatStorage( std::move( sources ) ),
+      StackReader( concatSource, prioritySize, bufferSize )
+{}
+
+bool ConcatReader::getLocation( size_t& index, uint64_t& offsetInSource ) const
+{
+    // Bytes read from the source, but not yet by the reader.
+    uint64_t unread = (uint64_t)( stackEnd - stackPtr );
+    for( const auto& seg : segments )
+        unread += (uint64_t)( seg.end - seg.ptr );
+
+    uint64_t read = concatSource.getBytesRead();
+    return concatSource.locate( read - std::min( read, unread ), index, offsetInSource );
+}
+
+}
@@ -0,0 +1,140 @@
+#ifndef CONCATSOURCE_HPP_INCLUDED
+#define CONCATSOURCE_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <cstdint>
+#include "bytesource.hpp"
+#include "blockingqueue.hpp"
+#include "stackreader.hpp"
+
+/*! Concatenation of the ordered files or sources, read as one stream.
+ *  - Files are opened on a background thread, which also reads the first
+ *    'headSize' bytes of each - small files are read whole. While the current
+ *    file is read, the next ones are already opened.
+ *  - Files which can't be opened are skipped, and counted.
+ */
+
+namespace gtools{
+
+class ConcatSource : public ByteSource{
+private:
+    // Source prepared by the opener. File smaller than the head is read
+    // whole, and has no 'source'. Head's buffer is given back to be reused.
+    struct PreparedSource{
+        size_t index;
+        std::unique_ptr< ByteSource > source;
+        std::unique_ptr< char[] > head;
+        size_t headLen;
+        bool failed;
+    };
+
+    std::vector< std::string > paths;
+    std::vector< std::unique_ptr< ByteSource > > sources;
+    size_t sourceCount = 0;
+    size_t headSize = DEFAULT_HEAD_SIZE;
+
+    // Opener thread gets the free slots, and gives back the prepared ones.
+    // Slot without a head is the stop signal.
+    std::thread openerThread;
+    BlockingQueue< PreparedSource > freeSlots;
+    BlockingQueue< PreparedSource > preparedSlots;
+
+    PreparedSource current = { 0, nullptr, nullptr, 0, false };
+    size_t headPos = 0;
+    size_t nextIndex = 0;
+    size_t failedCount = 0;
+
+    uint64_t bytesRead = 0;
+    uint64_t localOffset = 0;
+    std::vector< uint64_t > sourceStarts;
+
+    void openerLoop();
+    bool nextSource();
+
+public:
+    const static size_t DEFAULT_HEAD_SIZE = 64 * 1024;
+    const static size_t DEFAULT_LOOKAHEAD = 4;
+
+    // Files are read in order, 'lookahead' of them prepared in advance.
+    ConcatSource( const std::vector< std::string >& filePaths,
+                  size_t lookahead = DEFAULT_LOOKAHEAD, size_t headSize = DEFAULT_HEAD_SIZE );
+
+    // Sources (e.g. streams) are read in order, on the reading thread.
+    ConcatSource( std::vector< std::unique_ptr< ByteSource > > sources );
+
+    ~ConcatSource();
+
+    ConcatSource( const ConcatSource& ) = delete;
+    ConcatSource& operator=( const ConcatSource& ) = delete;
+
+    // Reads don't cross the sources - read ends at each source's end.
+    long read( char* buff, size_t len ) override;
+
+    // Sources are prefetched by the opener, and the offsets must follow
+    // the reading thread.
+    bool isPrefetchable() const override { return false; }
+
+    size_t getSourceCount() const { return sourceCount; }
+    size_t getFailedCount() const { return failedCount; }
+    uint64_t getBytesRead() const { return bytesRead; }
+
+    // Source being read, and the offset in it - of the read position, which
+    // is ahead of the reader by the buffered bytes.
+    size_t getCurrentIndex() const;
+    uint64_t getCurrentOffset() const { return localOffset; }
+
+    /*! Maps the offset in the concatenated stream to the source.
+     *  @return false if offset is past the bytes read so far.
+     */
+    bool locate( uint64_t offset, size_t& index, uint64_t& offsetInSource ) const;
+};
+
+/*! Storage of the ConcatReader, constructed before the StackReader.
+ */
+class ConcatStorage{
+protected:
+    ConcatSource concatSource;
+
+    ConcatStorage( const std::vector< std::string >& filePaths, size_t lookahead )
+        : concatSource( filePaths, lookahead ) {}
+    ConcatStorage( std::vector< std::unique_ptr< ByteSource > > sources )
+        : concatSource( std::move( sources ) ) {}
+};
+
+/*! StackReader over the ConcatSource, which knows the file and offset of
+ *  the next byte to be read.
+ *  - Sources are prefetched by the ConcatSource itself, so the reader's own
+ *    prefetching is refused - startPrefetch() returns false.
+ */
+class ConcatReader final : private ConcatStorage, public StackReader
+{
+public:
+    ConcatReader( const std::vector< std::string >& filePaths,
+                  size_t prioritySize = DEFAULT_PRIORITY_STACK,
+                  size_t bufferSize = DEFAULT_READBUFFER,
+                  size_t lookahead = ConcatSource::DEFAULT_LOOKAHEAD );
+
+    ConcatReader( std::vector< std::unique_ptr< ByteSource > > sources,
+                  size_t prioritySize = DEFAULT_PRIORITY_STACK,
+                  size_t bufferSize = DEFAULT_READBUFFER );
+
+    ConcatReader( const ConcatReader& ) = delete;
+    ConcatReader& operator=( const ConcatReader& ) = delete;
+
+    ConcatSource& getSource() { return concatSource; }
+
+    /*! Gets the source and the offset in it of the next byte. Bytes put
+     *  back count as not yet read.
+     *  - Exact if the next byte is buffered (e.g. after peekChar()). If not,
+     *    the next source may not be opened yet - end of the last one is given.
+     *  @return false if nothing was read yet.
+     */
+    bool getLocation( size_t& index, uint64_t& offsetInSource ) const;
+};
+
+}
+
+#endif // CONCATSOURCE_HPP_INCLUDED
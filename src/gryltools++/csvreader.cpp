@@ -0,0 +1,130 @@
+#include "csvreader.hpp"
+#include "scantools.hpp"
+
+namespace gtools{
+
+/*! Takes the next batch of the complete records from the reader, and
+ *  indexes it in one pass. Record cut by the window's end is left unread,
+ *  unless it's the only one - then more data is read until it's complete,
+ *  or the input ends.
+ *  @return false if input has ended.
+ */
+bool CsvReader::scanBatch()
+{
+    structurals.clear();
+    nextIndex = 0;
+    nextBegin = 0;
+
+    // Quote state and the delimiters of the record cut by the window's
+    // end carry over the refills. Offsets are from the batch start.
+    bool inQuotes = false;
+    size_t scanned = 0;
+    bool got = reader.getViewScanned( batch, [&]( const char* begin, const char* end ){
+        for( const char* p = begin; p < end; ){
+            const char* stop = ( (size_t)( end - p ) > BATCH_SIZE ? p + BATCH_SIZE : end );
+            size_t first = structurals.size();
+            ScanTools::indexDelimited( p, stop, delimiter, quote, inQuotes, structurals, 
+                                       scanned + (size_t)( p - begin ) );
+
+            // Batch ends after the last newline - record cut by it is
+            // indexed again in the next batch.
+            for( size_t i = structurals.size(); i-- > first; ){
+                if( begin[ structurals[i] - scanned ] == '\n' ){
+                    // Ending at the window's end, it's called again from there.
+                    const char* after = begin + ( structurals[i] + 1 - scanned );
+                    structurals.resize( i + 1 );
+                    scanned += (size_t)( after - begin );
+                    inQuotes = false;
+                    return after;
+                }
+            }
+            p = stop;
+        }
+        scanned += (size_t)( end - begin );
+        return end;
+    } );
+
+    // Last record of the input, without the newline, is in the quotes only
+    // if they weren't closed.
+    tailUnterminated = inQuotes;
+    return got;
+}
+
+bool CsvReader::nextRecord()
+{
+    if( nextBegin >= batch.size() && !scanBatch() )
+        return false;
+
+    const char* data = batch.data();
+    size_t begin = nextBegin;
+    size_t i = nextIndex;
+
+    // Unescaped fields are never longer than the batch - buffer won't move.
+    unescaped.clear();
+    if( unescaped.capacity() < batch.size() )
+        unescaped.reserve( batch.size() );
+
+    fields.clear();
+    for( ; i < structurals.size() && data[ structurals[i] ] != '\n'; i++ ){
+        fields.push_back( makeField( begin, structurals[i] ) );
+        begin = structurals[i] + 1;
+    }
+
+    size_t end;
+    if( i < structurals.size() ){
+        end = structurals[i];
+        unterminated = false;
+        nextIndex = i + 1;
+    }
+    else{
+        end = batch.size();
+        unterminated = tailUnterminated;
+        nextIndex = i;
+    }
+    record = Field{ data + nextBegin, end - nextBegin, false };
+    nextBegin = end + 1;
+
+    if( !unterminated && end > begin && data[ end - 1 ] == '\r' )
+        --end;
+    fields.push_back( makeField( begin, end ) );
+
+    ++recordCount;
+    return true;
+}
+
+/*! Field of the batch's bytes [begin, end). Quoted field is given without
+ *  the quotes. If it has escaped quotes, it's unescaped - doubled quote is
+ *  one quote, and single ones (malformed) are dropped.
+ */
+CsvReader::Field CsvReader::makeField( size_t begin, size_t end )
+{
+    const char* p = batch.data() + begin;
+    size_t len = end - begin;
+    if( !len || *p != quote )
+        return Field{ p, len, false };
+
+    // Quote closing at the end - field is inside the quotes.
+    const char* q = (const char*)std::memchr( p + 1, quote, len - 1 );
+    if( !q )
+        return Field{ p + 1, len - 1, true };
+    if( q == p + len - 1 )
+        return Field{ p + 1, len - 2, true };
+
+    size_t start = unescaped.size();
+    for( const char* s = p + 1, *e = p + len; s < e; ){
+        q = (const char*)std::memchr( s, quote, (size_t)( e - s ) );
+        if( !q )
+            q = e;
+        unescaped.append( s, (size_t)( q - s ) );
+
+        if( q + 1 < e && q[1] == quote ){
+            unescaped += quote;
+            s = q + 2;
+        }
+        else
+            s = q + 1;
+    }
+    return Field{ unescaped.data() + start, unescaped.size() - start, true };
+}
+
+}
@@ -0,0 +1,88 @@
+#ifndef CSVREADER_HPP_INCLUDED
+#define CSVREADER_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include "stackreader.hpp"
+
+/*! Delimited records (CSV, TSV) read over the StackReader.
+ *  - Record ends at the first newline outside of the quotes. Structure is
+ *    indexed by the vectorized ScanTools::indexDelimited().
+ *  - Records are indexed ahead in batches of about BATCH_SIZE bytes, taken
+ *    from the reader as one view, in one pass. Record spanning the refills is kept
+ *    contiguous by the reader, and the reader is not touched per record.
+ *  - Fields point into the batch, without copying. Only the quoted fields
+ *    with escaped quotes ("") are unescaped, into the reader's own buffer.
+ *  - "\r\n" line ends are accepted. Empty line is a record of one empty field.
+ */
+
+namespace gtools{
+
+class CsvReader{
+public:
+    // Field of the current record. Valid until the next record is read.
+    struct Field{
+        const char* data;
+        size_t size;
+        bool quoted;
+
+        std::string str() const { return std::string( data, size ); }
+
+        bool equals( const char* str, size_t sz ) const {
+            return sz == size && std::memcmp( data, str, sz ) == 0;
+        }
+        bool operator==( const std::string& str ) const { return equals( str.c_str(), str.size() ); }
+        bool operator==( const char* str ) const { return equals( str, std::strlen( str ) ); }
+        bool operator!=( const std::string& str ) const { return !( *this == str ); }
+        bool operator!=( const char* str ) const { return !( *this == str ); }
+    };
+
+private:
+    StackReader& reader;
+    char delimiter;
+    char quote;
+
+    // Offsets of the delimiters and newlines outside of the quotes - told
+    // apart by the byte at the offset.
+    StackReader::View batch;
+    std::vector< size_t > structurals;
+    size_t nextIndex = 0;
+    size_t nextBegin = 0;
+    bool tailUnterminated = false;
+
+    Field record = { nullptr, 0, false };
+    std::vector< Field > fields;
+    std::string unescaped;
+    size_t recordCount = 0;
+    bool unterminated = false;
+
+    bool scanBatch();
+    Field makeField( size_t begin, size_t end );
+
+public:
+    const static size_t BATCH_SIZE = 64 * 1024;
+
+    CsvReader( StackReader& rdr, char delimiter = ',', char quote = '"' )
+        : reader( rdr ), delimiter( delimiter ), quote( quote ) {}
+
+    /*! Reads the next record, and splits it to the fields.
+     *  @return false if input has ended.
+     */
+    bool nextRecord();
+
+    size_t size() const { return fields.size(); }
+    const Field& operator[]( size_t i ) const { return fields[i]; }
+    const std::vector< Field >& getFields() const { return fields; }
+
+    // Raw bytes of the current record, without the '\n'.
+    const Field& getRecord() const { return record; }
+    size_t getRecordCount() const { return recordCount; }
+
+    // Current record's quote was not closed - it spans to the end of input.
+    bool isUnterminated() const { return unterminated; }
+};
+
+}
+
+#endif // CSVREADER_HPP_INCLUDED
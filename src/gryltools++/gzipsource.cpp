@@ -0,0 +1,235 @@
+#include "gzipsource.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <zlib.h>
+
+#if defined _GRYLTOOL_POSIX
+    #include <fcntl.h>
+#endif
+
+namespace gtools{
+
+/*! Decompression state. Used by one thread at a time - the helper thread,
+ *  or the reading one if not threaded.
+ */
+struct GzipSource::Inflater{
+    const static size_t INPUT_SIZE = 64 * 1024;
+
+    ByteSource& input;
+    z_stream strm;
+    std::unique_ptr< unsigned char[] > inBuf;
+
+    bool started = false;
+    bool compressed = false;
+    bool memberEnded = false;
+    bool error = false;
+
+    Inflater( ByteSource& in ) : input( in ), inBuf( new unsigned char[ INPUT_SIZE ] ) {
+        std::memset( &strm, 0, sizeof( strm ) );
+    }
+
+    ~Inflater(){
+        if( compressed )
+            inflateEnd( &strm );
+    }
+
+    /*! Reads more compressed input, if all was used.
+     *  @return false if input has ended.
+     */
+    bool fillInput(){
+        if( strm.avail_in )
+            return true;
+        long red = input.read( (char*)inBuf.get(), INPUT_SIZE );
+        if( red <= 0 ){
+            if( red < 0 )
+                error = true;
+            return false;
+        }
+        strm.next_in = inBuf.get();
+        strm.avail_in = (uInt)red;
+        return true;
+    }
+
+    /*! Checks the gzip header's magic - without it, input is passed through.
+     */
+    void start(){
+        started = true;
+        while( strm.avail_in < 2 ){
+            long red = input.read( (char*)inBuf.get() + strm.avail_in, INPUT_SIZE - strm.avail_in );
+            if( red <= 0 ){
+                if( red < 0 )
+                    error = true;
+                break;
+            }
+            strm.avail_in += (uInt)red;
+        }
+        strm.next_in = inBuf.get();
+
+        if( strm.avail_in >= 2 && inBuf[0] == 0x1F && inBuf[1] == 0x8B ){
+            // Window bits 15 + 16 - gzip format only.
+            compressed = ( inflateInit2( &strm, 15 + 16 ) == Z_OK );
+            if( !compressed )
+                error = true;
+        }
+    }
+
+    /*! Fills 'out' with decompressed data, until it's full or input ends.
+     *  @return bytes written, 0 on the end, -1 on error with nothing written.
+     */
+    long inflateInto( char* out, size_t len ){
+        if( !started )
+            start();
+        if( error && !compressed )
+            return -1;
+
+        if( !compressed ){
+            if( strm.avail_in ){
+                size_t sz = std::min( len, (size_t)strm.avail_in );
+                std::memcpy( out, strm.next_in, sz );
+                strm.next_in += sz;
+                strm.avail_in -= (uInt)sz;
+                return (long)sz;
+            }
+            return input.read( out, len );
+        }
+
+        strm.next_out = (unsigned char*)out;
+        strm.avail_out = (uInt)std::min( len, (size_t)UINT32_MAX );
+        size_t outLen = strm.avail_out;
+
+        while( strm.avail_out && !error ){
+            if( !fillInput() ){
+                // Input ending inside a member is truncated.
+                if( !memberEnded )
+                    error = true;
+                break;
+            }
+
+            // Next member of concatenated gzip.
+            if( memberEnded ){
+                if( inflateReset( &strm ) != Z_OK ){
+                    error = true;
+                    break;
+                }
+                memberEnded = false;
+            }
+
+            int ret = inflate( &strm, Z_NO_FLUSH );
+            if( ret == Z_STREAM_END )
+                memberEnded = true;
+            else if( ret != Z_OK && ret != Z_BUF_ERROR )
+                error = true;
+        }
+
+        size_t produced = outLen - strm.avail_out;
+        if( !produced && error )
+            return -1;
+        return (long)produced;
+    }
+};
+
+GzipSource::GzipSource( std::unique_ptr< ByteSource > compressed, bool thrd,
+                        size_t blkSize, size_t blockCount )
+    : input( std::move( compressed ) ), threaded( thrd ), blockSize( blkSize ? blkSize : 1 )
+{
+    setup( blockCount );
+}
+
+GzipSource::GzipSource( const char* filePath, bool thrd, size_t blkSize, size_t blockCount )
+    : threaded( thrd ), blockSize( blkSize ? blkSize : 1 )
+{
+#if defined _GRYLTOOL_POSIX
+    int fd = open( filePath, O_RDONLY );
+    if( fd >= 0 )
+        input.reset( new FdSource( fd, true ) );
+#else
+    FILE* file = std::fopen( filePath, "rb" );
+    if( file )
+        input.reset( new CFileSource( file, true ) );
+#endif
+    setup( blockCount );
+}
+
+void GzipSource::setup( size_t blockCount )
+{
+    if( !input )
+        return;
+    inflater.reset( new Inflater( *input ) );
+    if( !threaded )
+        return;
+
+    blockCount = std::max( blockCount, (size_t)2 );
+    blockMemory.reset( new char[ blockSize * blockCount ] );
+    freeBlocks.reset( new BlockingQueue< Block >() );
+    filledBlocks.reset( new BlockingQueue< Block >() );
+    for( size_t i = 0; i < blockCount; i++ )
+        freeBlocks->push( Block{ blockMemory.get() + i * blockSize, 0 } );
+
+    inflateThread = std::thread( &GzipSource::inflateLoop, this );
+}
+
+GzipSource::~GzipSource()
+{
+    // Wake the helper if it's waiting for a free block, and wait for it.
+    if( inflateThread.joinable() ){
+        freeBlocks->push( Block{ nullptr, 0 } );
+        inflateThread.join();
+    }
+}
+
+/*! Helper thread's loop. Fills the free blocks until the data ends, or a
+ *  block without data is received (stop signal).
+ */
+void GzipSource::inflateLoop()
+{
+    while( true ){
+        Block block = freeBlocks->pop();
+        if( !block.data )
+            break;
+
+        block.size = inflater->inflateInto( block.data, blockSize );
+        filledBlocks->push( block );
+        if( block.size <= 0 )
+            break;
+    }
+}
+
+long GzipSource::read( char* buff, size_t len )
+{
+    if( !inflater )
+        return -1;
+    if( !len )
+        return 0;
+    if( !threaded )
+        return inflater->inflateInto( buff, len );
+
+    if( currentPos >= (size_t)std::max( current.size, 0L ) ){
+        if( ended )
+            return current.size;
+        if( current.data )
+            freeBlocks->push( current );
+
+        current = filledBlocks->pop();
+        currentPos = 0;
+        if( current.size <= 0 ){
+            ended = true;
+            return current.size;
+        }
+    }
+
+    size_t sz = std::min( len, (size_t)current.size - currentPos );
+    std::memcpy( buff, current.data + currentPos, sz );
+    currentPos += sz;
+    return (long)sz;
+}
+
+bool GzipSource::hasError() const {
+    return ( !inflater || inflater->error );
+}
+
+bool GzipSource::isCompressed() const {
+    return ( inflater && inflater->compressed );
+}
+
+}
@@ -0,0 +1,78 @@
+#ifndef GZIPSOURCE_HPP_INCLUDED
+#define GZIPSOURCE_HPP_INCLUDED
+
+#include <memory>
+#include <thread>
+#include "bytesource.hpp"
+#include "blockingqueue.hpp"
+
+/*! Gzip-compressed input, decompressed by zlib. Built only with zlib
+ *  (WITH_ZLIB=yes, the default).
+ *  - Input without the gzip header is passed through as it is, so plain
+ *    and compressed files can be read the same way.
+ *  - Concatenated gzip members are read as one stream.
+ *  - Threaded source inflates on a helper thread, in large blocks, while
+ *    the previous ones are parsed. Otherwise it inflates straight into the
+ *    reader's buffer - then the reader's buffer should be large too.
+ */
+
+namespace gtools{
+
+class GzipSource : public ByteSource{
+private:
+    struct Inflater;
+
+    struct Block{
+        char* data;
+        long size;
+    };
+
+    std::unique_ptr< ByteSource > input;
+    std::unique_ptr< Inflater > inflater;
+
+    // Threaded mode - helper thread gets the free blocks, and gives back the
+    // filled ones. Block without data is the stop signal.
+    bool threaded;
+    size_t blockSize;
+    std::unique_ptr< char[] > blockMemory;
+    std::thread inflateThread;
+    std::unique_ptr< BlockingQueue< Block > > freeBlocks;
+    std::unique_ptr< BlockingQueue< Block > > filledBlocks;
+    Block current = { nullptr, 0 };
+    size_t currentPos = 0;
+    bool ended = false;
+
+    void setup( size_t blockCount );
+    void inflateLoop();
+
+public:
+    const static size_t DEFAULT_BLOCK_SIZE = 256 * 1024;
+    const static size_t DEFAULT_BLOCK_COUNT = 3;
+
+    explicit GzipSource( std::unique_ptr< ByteSource > compressed, bool threaded = true,
+                         size_t blockSize = DEFAULT_BLOCK_SIZE,
+                         size_t blockCount = DEFAULT_BLOCK_COUNT );
+
+    explicit GzipSource( const char* filePath, bool threaded = true,
+                         size_t blockSize = DEFAULT_BLOCK_SIZE,
+                         size_t blockCount = DEFAULT_BLOCK_COUNT );
+
+    ~GzipSource();
+
+    GzipSource( const GzipSource& ) = delete;
+    GzipSource& operator=( const GzipSource& ) = delete;
+
+    long read( char* buff, size_t len ) override;
+
+    // False if the file couldn't be opened.
+    bool isOpen() const { return (bool)input; }
+
+    // Known once the source is read to the end: whether the data was corrupt
+    // or truncated, and whether it was compressed at all.
+    bool hasError() const;
+    bool isCompressed() const;
+};
+
+}
+
+#endif // GZIPSOURCE_HPP_INCLUDED
@@ -0,0 +1,690 @@
+#include <map>
+#include <algorithm>
+#include <cctype>
+#include "lexer.hpp"
+#include "scantools.hpp"
+
+namespace gtools{
+
+/*! Thompson NFA state. Has either a character transition to 'next', or
+ *  epsilon transitions. Accepting states have the rule's priority set.
+ */
+struct NfaState{
+    CharSet set;
+    int next = -1;
+    std::vector< int > eps;
+    int rule = -1;
+};
+
+/*! Recursive descent regex parser, building the NFA fragments.
+ *  - Fragment's states are contiguous - [first, states.size()) right after
+ *    it's parsed, so they can be cloned for the counted repetitions.
+ */
+class RegexParser{
+private:
+    const static size_t MAX_REPEAT = 1000;
+
+    struct Fragment{
+        int first;
+        int start;
+        int end;
+    };
+
+    std::vector< NfaState >& states;
+    const std::string& re;
+    std::string& error;
+    size_t pos = 0;
+
+    int newState(){
+        states.push_back( NfaState() );
+        return (int)states.size() - 1;
+    }
+
+    bool fail( const std::string& msg ){
+        error = "Regex \"" + re + "\": " + msg + " at position " + std::to_string( pos );
+        return false;
+    }
+
+    bool more() const { return pos < re.size(); }
+    char peek() const { return re[ pos ]; }
+
+    Fragment emptyFragment(){
+        int s = newState();
+        return Fragment{ s, s, s };
+    }
+
+    Fragment charFragment( const CharSet& set ){
+        int s = newState();
+        int e = newState();
+        states[ s ].set = set;
+        states[ s ].next = e;
+        return Fragment{ s, s, e };
+    }
+
+    Fragment cloneFragment( const Fragment& f, int limit );
+    void concat( Fragment& f, const Fragment& g );
+
+    bool parseAlternation( Fragment& f );
+    bool parseConcatenation( Fragment& f );
+    bool parseRepetition( Fragment& f );
+    bool parseAtom( Fragment& f );
+    bool parseCount( size_t& minCount, size_t& maxCount, bool& unbounded );
+    bool parseEscape( CharSet& set );
+    bool parseClass( CharSet& set );
+    bool parsePosixClass( CharSet& set );
+
+public:
+    RegexParser( std::vector< NfaState >& states, const std::string& re, std::string& error )
+        : states( states ), re( re ), error( error ) {}
+
+    bool parse( int& start, int& end );
+};
+
+/*! Copies the fragment's states [f.first, limit) after the last state.
+ */
+RegexParser::Fragment RegexParser::cloneFragment( const Fragment& f, int limit )
+{
+    int last = (int)states.size();
+    int offset = last - f.first;
+
+    for( int i = f.first; i < limit; i++ ){
+        NfaState st = states[ i ];
+        if( st.next >= 0 )
+            st.next += offset;
+        for( auto& e : st.eps )
+            e += offset;
+        states.push_back( st );
+    }
+    return Fragment{ last, f.start + offset, f.end + offset };
+}
+
+void RegexParser::concat( Fragment& f, const Fragment& g )
+{
+    states[ f.end ].eps.push_back( g.start );
+    f.end = g.end;
+}
+
+bool RegexParser::parse( int& start, int& end )
+{
+    Fragment f;
+    if( !parseAlternation( f ) )
+        return false;
+    if( more() )
+        return fail( "unmatched ')'" );
+
+    start = f.start;
+    end = f.end;
+    return true;
+}
+
+bool RegexParser::parseAlternation( Fragment& f )
+{
+    if( !parseConcatenation( f ) )
+        return false;
+
+    while( more() && peek() == '|' ){
+        pos++;
+        Fragment g;
+        if( !parseConcatenation( g ) )
+            return false;
+
+        int s = newState();
+        int e = newState();
+        states[ s ].eps = { f.start, g.start };
+        states[ f.end ].eps.push_back( e );
+        states[ g.end ].eps.push_back( e );
+        f = Fragment{ f.first, s, e };
+    }
+    return true;
+}
+
+bool RegexParser::parseConcatenation( Fragment& f )
+{
+    f = emptyFragment();
+    while( more() && peek() != '|' && peek() != ')' ){
+        Fragment g;
+        if( !parseRepetition( g ) )
+            return false;
+        concat( f, g );
+    }
+    return true;
+}
+
+bool RegexParser::parseRepetition( Fragment& f )
+{
+    if( !parseAtom( f ) )
+        return false;
+
+    while( more() ){
+        char c = peek();
+        if( c == '*' || c == '?' ){
+            pos++;
+            int s = newState();
+            int e = newState();
+            states[ s ].eps = { f.start, e };
+            states[ f.end ].eps.push_back( e );
+            if( c == '*' )
+                states[ f.end ].eps.push_back( f.start );
+            f = Fragment{ f.first, s, e };
+        }
+        else if( c == '+' ){
+            pos++;
+            int e = newState();
+            states[ f.end ].eps.push_back( f.start );
+            states[ f.end ].eps.push_back( e );
+            f.end = e;
+        }
+        else if( c == '{' ){
+            size_t minCount, maxCount;
+            bool unbounded;
+            if( !parseCount( minCount, maxCount, unbounded ) )
+                return false;
+
+            // Clone all the copies first, as concatenating modifies the fragment.
+            size_t copyCount = ( unbounded ? minCount + 1 : maxCount );
+            int limit = (int)states.size();
+            std::vector< Fragment > copies;
+            for( size_t i = 0; i < copyCount; i++ )
+                copies.push_back( i ? cloneFragment( f, limit ) : f );
+
+            Fragment r = emptyFragment();
+            r.first = f.first;
+            for( size_t i = 0; i < minCount; i++ )
+                concat( r, copies[i] );
+
+            if( unbounded ){
+                Fragment& g = copies[ minCount ];
+                int e = newState();
+                states[ g.end ].eps.push_back( g.start );
+                states[ g.end ].eps.push_back( e );
+                states[ r.end ].eps.push_back( g.start );
+                states[ r.end ].eps.push_back( e );
+                r.end = e;
+            }
+            else{
+                // Optional copies - each can be skipped to the end.
+                int e = newState();
+                for( size_t i = minCount; i < maxCount; i++ ){
+                    states[ r.end ].eps.push_back( e );
+                    concat( r, copies[i] );
+                }
+                states[ r.end ].eps.push_back( e );
+                r.end = e;
+            }
+            f = r;
+        }
+        else
+            break;
+    }
+    return true;
+}
+
+bool RegexParser::parseCount( size_t& minCount, size_t& maxCount, bool& unbounded )
+{
+    pos++; // '{'
+    auto number = [this]( size_t& val ) -> bool {
+        size_t start = pos;
+        val = 0;
+        while( more() && std::isdigit( (unsigned char)peek() ) && val <= MAX_REPEAT )
+            val = val * 10 + (size_t)( re[ pos++ ] - '0' );
+        return pos > start;
+    };
+
+    unbounded = false;
+    if( !number( minCount ) )
+        return fail( "expected repetition count" );
+
+    maxCount = minCount;
+    if( more() && peek() == ',' ){
+        pos++;
+        if( more() && peek() == '}' )
+            unbounded = true;
+        else if( !number( maxCount ) )
+            return fail( "expected repetition count" );
+    }
+
+    if( !more() || peek() != '}' )
+        return fail( "expected '}'" );
+    pos++;
+
+    if( minCount > MAX_REPEAT || maxCount > MAX_REPEAT )
+        return fail( "repetition count too large" );
+    if( maxCount < minCount )
+        return fail( "invalid repetition range" );
+    return true;
+}
+
+bool RegexParser::parseAtom( Fragment& f )
+{
+    char c = re[ pos ];
+    switch( c ){
+    case '(':
+        pos++;
+        if( re.compare( pos, 2, "?:" ) == 0 )
+            pos += 2;
+        if( !parseAlternation( f ) )
+            return false;
+        if( !more() || peek() != ')' )
+            return fail( "expected ')'" );
+        pos++;
+        return true;
+
+    case '[':{
+        CharSet set;
+        if( !parseClass( set ) )
+            return false;
+        f = charFragment( set );
+        return true;
+    }
+    case '.':
+        pos++;
+        f = charFragment( CharSet( '\n' ).inverted() );
+        return true;
+
+    case '\\':{
+        CharSet set;
+        if( !parseEscape( set ) )
+            return false;
+        f = charFragment( set );
+        return true;
+    }
+    case '*': case '+': case '?': case '{':
+        return fail( "nothing to repeat" );
+
+    default:
+        pos++;
+        f = charFragment( CharSet( c ) );
+        return true;
+    }
+}
+
+/*! Parses the escape sequence at '\', adding it's characters to the set.
+ */
+bool RegexParser::parseEscape( CharSet& set )
+{
+    pos++; // '\'
+    if( !more() )
+        return fail( "trailing '\\'" );
+
+    char c = re[ pos++ ];
+    switch( c ){
+    case 'd': set.addRange( '0', '9' ); break;
+    case 'D': set.add( CharSet().addRange( '0', '9' ).inverted() ); break;
+    case 'w': set.add( CharSet().addRange( 'a', 'z' ).addRange( 'A', 'Z' )
+                                .addRange( '0', '9' ).add( '_' ) ); break;
+    case 'W': set.add( CharSet().addRange( 'a', 'z' ).addRange( 'A', 'Z' )
+                                .addRange( '0', '9' ).add( '_' ).inverted() ); break;
+    case 's': set.add( CharSet( " \t\n\r\f\v", 6 ) ); break;
+    case 'S': set.add( CharSet( " \t\n\r\f\v", 6 ).inverted() ); break;
+    case 'n': set.add( '\n' ); break;
+    case 't': set.add( '\t' ); break;
+    case 'r': set.add( '\r' ); break;
+    case 'f': set.add( '\f' ); break;
+    case 'v': set.add( '\v' ); break;
+    case '0': set.add( '\0' ); break;
+    case 'x':{
+        if( pos + 2 > re.size() || !std::isxdigit( (unsigned char)re[pos] ) ||
+            !std::isxdigit( (unsigned char)re[pos+1] ) )
+            return fail( "expected two hex digits" );
+        set.add( (char)std::stoi( re.substr( pos, 2 ), nullptr, 16 ) );
+        pos += 2;
+        break;
+    }
+    case 'b': case 'B':
+        return fail( "word boundaries are not supported" );
+    default:
+        if( std::isalnum( (unsigned char)c ) )
+            return fail( std::string( "unknown escape \\" ) + c );
+        set.add( c );
+    }
+    return true;
+}
+
+bool RegexParser::parsePosixClass( CharSet& set )
+{
+    size_t end = re.find( ":]", pos + 2 );
+    if( end == std::string::npos )
+        return fail( "unterminated POSIX class" );
+
+    std::string name = re.substr( pos + 2, end - pos - 2 );
+    int (*pred)( int ) = nullptr;
+    if( name == "alpha" )       pred = isalpha;
+    else if( name == "digit" )  pred = isdigit;
+    else if( name == "alnum" )  pred = isalnum;
+    else if( name == "space" )  pred = isspace;
+    else if( name == "upper" )  pred = isupper;
+    else if( name == "lower" )  pred = islower;
+    else if( name == "punct" )  pred = ispunct;
+    else if( name == "xdigit" ) pred = isxdigit;
+    else if( name == "blank" )  pred = isblank;
+    else if( name == "cntrl" )  pred = iscntrl;
+    else if( name == "print" )  pred = isprint;
+    else if( name == "graph" )  pred = isgraph;
+    else if( name != "word" )
+        return fail( "unknown POSIX class " + name );
+
+    // Only ASCII - classes must not depend on the locale.
+    for( int i = 0; i < 128; i++ ){
+        if( pred ? pred( i ) : ( isalnum( i ) || i == '_' ) )
+            set.add( (char)i );
+    }
+    pos = end + 2;
+    return true;
+}
+
+bool RegexParser::parseClass( CharSet& set )
+{
+    pos++; // '['
+    bool negate = false;
+    if( more() && peek() == '^' ){
+        negate = true;
+        pos++;
+    }
+
+    CharSet members;
+    bool first = true;
+    while( more() && ( peek() != ']' || first ) ){
+        first = false;
+
+        if( re.compare( pos, 2, "[:" ) == 0 ){
+            if( !parsePosixClass( members ) )
+                return false;
+            continue;
+        }
+
+        // Single character, or an escape. Escaped classes can't be ranges.
+        char from = peek();
+        if( from == '\\' ){
+            CharSet esc;
+            if( !parseEscape( esc ) )
+                return false;
+            if( esc.size() != 1 ){
+                members.add( esc );
+                continue;
+            }
+            esc.getMembers( &from, 1 );
+        }
+        else
+            pos++;
+
+        if( pos + 1 < re.size() && peek() == '-' && re[ pos+1 ] != ']' ){
+            pos++;
+            char to = peek();
+            if( to == '\\' ){
+                CharSet esc;
+                if( !parseEscape( esc ) )
+                    return false;
+                if( esc.size() != 1 )
+                    return fail( "invalid range end" );
+                esc.getMembers( &to, 1 );
+            }
+            else
+                pos++;
+
+            if( (unsigned char)to < (unsigned char)from )
+                return fail( "invalid range" );
+            members.addRange( from, to );
+        }
+        else
+            members.add( from );
+    }
+
+    if( !more() )
+        return fail( "unterminated character class" );
+    pos++; // ']'
+
+    set = ( negate ? members.inverted() : members );
+    return true;
+}
+
+//============================ DFA building ============================//
+
+/*! Adds the epsilon closure of the 'states' to it, and sorts it.
+ */
+static void epsilonClosure( const std::vector< NfaState >& nfa, std::vector< int >& states )
+{
+    std::vector< bool > seen( nfa.size(), false );
+    std::vector< int > stack( states );
+    states.clear();
+
+    while( !stack.empty() ){
+        int s = stack.back();
+        stack.pop_back();
+        if( seen[ s ] )
+            continue;
+
+        seen[ s ] = true;
+        states.push_back( s );
+        for( int e : nfa[ s ].eps )
+            stack.push_back( e );
+    }
+    std::sort( states.begin(), states.end() );
+}
+
+/*! Splits the bytes into classes of bytes, which no transition tells apart.
+ *  @return count of classes.
+ */
+static uint32_t computeByteClasses( const std::vector< NfaState >& nfa, std::vector< uint8_t >& classMap )
+{
+    std::vector< int > cls( 256, 0 );
+    int classCount = 1;
+
+    for( const auto& st : nfa ){
+        if( st.next < 0 )
+            continue;
+
+        // Split every class by membership in this set.
+        std::map< std::pair< int, bool >, int > split;
+        for( int b = 0; b < 256; b++ ){
+            auto key = std::make_pair( cls[b], st.set.contains( (char)b ) );
+            auto it = split.find( key );
+            if( it == split.end() )
+                it = split.insert( std::make_pair( key, (int)split.size() ) ).first;
+            cls[b] = it->second;
+        }
+        classCount = (int)split.size();
+    }
+
+    classMap.resize( 256 );
+    for( int b = 0; b < 256; b++ )
+        classMap[b] = (uint8_t)cls[b];
+    return (uint32_t)classCount;
+}
+
+bool DfaBuilder::addRule( int32_t id, const std::string& regex )
+{
+    if( id < 0 ){
+        lastError = "Rule id must not be negative";
+        return false;
+    }
+
+    // Verify the regex now, so that the error points to the rule.
+    std::vector< NfaState > nfa;
+    int start, end;
+    RegexParser parser( nfa, regex, lastError );
+    if( !parser.parse( start, end ) )
+        return false;
+
+    rules.push_back( Rule{ id, regex } );
+    built = false;
+    return true;
+}
+
+/*! Builds the minimized DFA of all the rules.
+ *  - Rules are joined to one NFA, which is turned to DFA by the subset
+ *    construction, on the byte classes instead of single bytes.
+ *  - DFA is minimized by Moore's partition refinement, starting from the
+ *    partition by accepted token.
+ */
+bool DfaBuilder::build()
+{
+    // NFA of all rules: state 0 branches to every rule.
+    std::vector< NfaState > nfa( 1 );
+    for( size_t i = 0; i < rules.size(); i++ ){
+        int start, end;
+        RegexParser parser( nfa, rules[i].regex, lastError );
+        if( !parser.parse( start, end ) )
+            return false;
+
+        nfa[ 0 ].eps.push_back( start );
+        nfa[ end ].rule = (int)i;
+    }
+
+    classCount = computeByteClasses( nfa, classMap );
+
+    std::vector< uint8_t > classRep( classCount );
+    for( int b = 255; b >= 0; b-- )
+        classRep[ classMap[b] ] = (uint8_t)b;
+
+    // Subset construction. State 0 is dead (empty set), 1 is start.
+    std::map< std::vector< int >, uint32_t > stateIds;
+    std::vector< std::vector< int > > dfaStates;
+    std::vector< uint32_t > trans;
+
+    dfaStates.push_back( std::vector< int >() );
+    stateIds[ dfaStates[0] ] = 0;
+
+    std::vector< int > startSet{ 0 };
+    epsilonClosure( nfa, startSet );
+    stateIds[ startSet ] = 1;
+    dfaStates.push_back( startSet );
+
+    for( size_t d = 0; d < dfaStates.size(); d++ ){
+        for( uint32_t c = 0; c < classCount; c++ ){
+            std::vector< int > target;
+            for( int s : dfaStates[ d ] ){
+                if( nfa[ s ].next >= 0 && nfa[ s ].set.contains( (char)classRep[c] ) )
+                    target.push_back( nfa[ s ].next );
+            }
+            epsilonClosure( nfa, target );
+
+            auto it = stateIds.find( target );
+            if( it == stateIds.end() ){
+                it = stateIds.insert( std::make_pair( target, (uint32_t)dfaStates.size() ) ).first;
+                dfaStates.push_back( target );
+            }
+            trans.push_back( it->second );
+        }
+    }
+
+    size_t count = dfaStates.size();
+    std::vector< int32_t > tokens( count, -1 );
+    for( size_t d = 0; d < count; d++ ){
+        int best = -1;
+        for( int s : dfaStates[ d ] ){
+            if( nfa[ s ].rule >= 0 && ( best < 0 || nfa[ s ].rule < best ) )
+                best = nfa[ s ].rule;
+        }
+        if( best >= 0 )
+            tokens[ d ] = rules[ best ].id;
+    }
+
+    // Minimization. Dead state's and start state's blocks are numbered first,
+    // so they stay 0 and 1 (unless start is equivalent to dead).
+    std::vector< uint32_t > block( count );
+    uint32_t blockCount = 0;
+    while( true ){
+        std::map< std::vector< int64_t >, uint32_t > signatures;
+        std::vector< uint32_t > newBlock( count );
+        std::vector< size_t > order{ 0, 1 };
+        for( size_t d = 2; d < count; d++ )
+            order.push_back( d );
+
+        for( size_t d : order ){
+            std::vector< int64_t > sig;
+            sig.push_back( tokens[ d ] );
+            if( blockCount ){
+                sig.push_back( block[ d ] );
+                for( uint32_t c = 0; c < classCount; c++ )
+                    sig.push_back( block[ trans[ d * classCount + c ] ] );
+            }
+
+            auto it = signatures.find( sig );
+            if( it == signatures.end() )
+                it = signatures.insert( std::make_pair( sig, (uint32_t)signatures.size() ) ).first;
+            newBlock[ d ] = it->second;
+        }
+
+        bool stable = ( signatures.size() == blockCount );
+        block = newBlock;
+        blockCount = (uint32_t)signatures.size();
+        if( stable )
+            break;
+    }
+
+    // Start can be dead only if no rule can match anything - keep it separate.
+    uint32_t stateCount = std::max< uint32_t >( blockCount, 2 );
+    transitions.assign( (size_t)stateCount * classCount, 0 );
+    tokenIds.assign( stateCount, -1 );
+    for( size_t d = 0; d < count; d++ ){
+        uint32_t b = block[ d ];
+        if( d == 1 && b == 0 )
+            b = 1;
+        else if( block[ d ] == 0 )
+            continue;
+
+        tokenIds[ b ] = tokens[ d ];
+        for( uint32_t c = 0; c < classCount; c++ )
+            transitions[ b * classCount + c ] = block[ trans[ d * classCount + c ] ];
+    }
+
+    built = true;
+    return true;
+}
+
+DfaTables DfaBuilder::getTables() const
+{
+    return DfaTables{ classMap.data(), transitions.data(), tokenIds.data(),
+                      getStateCount(), classCount };
+}
+
+//============================= Lexer ============================//
+
+/*! Moves the line and column past the token's data.
+ */
+void Lexer::advancePosition( const StackReader::View& data )
+{
+    // Tokens are mostly short - the vectorized count is only worth it for long ones.
+    const char* lastNewline = nullptr;
+    size_t newlines = 0;
+    if( data.size() >= 64 )
+        newlines = ScanTools::countNewlines( data.begin(), data.end(), lastNewline );
+    else{
+        for( const char* p = data.begin(); p < data.end(); p++ ){
+            if( *p == '\n' ){
+                newlines++;
+                lastNewline = p;
+            }
+        }
+    }
+
+    if( newlines ){
+        line += newlines;
+        column = (size_t)( data.end() - lastNewline - 1 );
+    }
+    else
+        column += data.size();
+}
+
+/*! Gets the longest token from the current position. If no rule matches,
+ *  one byte is returned as the Token::UNKNOWN token.
+ *  @return false if no more data.
+ */
+bool Lexer::getNextToken( Token& tok )
+{
+    tok.line = line;
+    tok.column = column;
+
+    uint32_t state;
+    if( reader.getViewLongest( tok.data, tables, state ) )
+        tok.id = tables.tokenId( state );
+    else if( reader.getView( tok.data, 1 ) )
+        tok.id = Token::UNKNOWN;
+    else
+        return false;
+
+    advancePosition( tok.data );
+    return true;
+}
+
+}
@@ -0,0 +1,115 @@
+#ifndef LEXER_HPP_INCLUDED
+#define LEXER_HPP_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "stackreader.hpp"
+#include "charclass.hpp"
+
+/*! Multi-regex lexer.
+ *  - DfaBuilder compiles (token id, regex) rules into one minimized DFA.
+ *  - Lexer runs the DFA over the StackReader, returning the longest match.
+ *    If several rules match the same longest lexeme, the one added first
+ *    wins.
+ *
+ *  Supported regex syntax: literals, '.', escapes (\d \w \s \D \W \S \n \t
+ *  \r \f \v \0 \xHH, and escaped metacharacters), classes [a-z], negated
+ *  classes [^...], POSIX classes [[:alpha:]], groups (...), alternation |,
+ *  and repetitions * + ? {m} {m,} {m,n}.
+ */
+
+namespace gtools{
+
+/*! DFA tables, as used by the Lexer. Tables are not owned.
+ *  - Bytes are mapped to the equivalence classes by 'classMap'.
+ *  - State 0 is the dead state, and 1 is the start state.
+ *  - tokenIds[state] is the token id, or -1 if state is not accepting.
+ */
+struct DfaTables{
+    const uint8_t* classMap;
+    const uint32_t* transitions;
+    const int32_t* tokenIds;
+    uint32_t stateCount;
+    uint32_t classCount;
+
+    const static uint32_t DEAD_STATE = 0;
+    const static uint32_t START_STATE = 1;
+
+    uint32_t start() const { return START_STATE; }
+    uint32_t step( uint32_t state, char c ) const {
+        return transitions[ state * classCount + classMap[ (unsigned char)c ] ];
+    }
+    bool accepts( uint32_t state ) const { return tokenIds[ state ] >= 0; }
+    int32_t tokenId( uint32_t state ) const { return tokenIds[ state ]; }
+};
+
+class DfaBuilder{
+private:
+    struct Rule{
+        int32_t id;
+        std::string regex;
+    };
+    std::vector< Rule > rules;
+
+    std::vector< uint8_t > classMap;
+    std::vector< uint32_t > transitions;
+    std::vector< int32_t > tokenIds;
+    uint32_t classCount = 0;
+    bool built = false;
+
+    std::string lastError;
+
+public:
+    /*! Adds a rule. Rule's id must not be negative.
+     *  @return false if regex is invalid - see getLastError().
+     */
+    bool addRule( int32_t id, const std::string& regex );
+    bool build();
+
+    bool isBuilt() const { return built; }
+    const std::string& getLastError() const { return lastError; }
+
+    // Tables point to the builder's memory, valid until next build.
+    DfaTables getTables() const;
+    uint32_t getStateCount() const { return (uint32_t)tokenIds.size(); }
+    uint32_t getClassCount() const { return classCount; }
+
+    const std::vector< uint8_t >& getClassMap() const { return classMap; }
+    const std::vector< uint32_t >& getTransitions() const { return transitions; }
+    const std::vector< int32_t >& getTokenIds() const { return tokenIds; }
+};
+
+struct Token{
+    const static int32_t UNKNOWN = -1;
+
+    int32_t id = UNKNOWN;
+    StackReader::View data;
+
+    // Position of the token's first byte, 0-based.
+    size_t line = 0;
+    size_t column = 0;
+};
+
+class Lexer{
+private:
+    StackReader& reader;
+    DfaTables tables;
+
+    size_t line = 0;
+    size_t column = 0;
+
+    void advancePosition( const StackReader::View& data );
+
+public:
+    Lexer( StackReader& rdr, const DfaTables& tables ) : reader( rdr ), tables( tables ) {}
+
+    bool getNextToken( Token& tok );
+
+    size_t getLine() const { return line; }
+    size_t getColumn() const { return column; }
+};
+
+}
+
+#endif // LEXER_HPP_INCLUDED
@@ -0,0 +1,356 @@
+#include <cstring>
+#include "lineindex.hpp"
+
+#if defined _GRYLTOOL_POSIX
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/stat.h>
+#endif
+
+namespace gtools{
+
+// Sidecar file header: magic, version, then the fixed fields.
+static const char SIDECAR_MAGIC[4] = { 'G', 'L', 'I', 'X' };
+static const unsigned char SIDECAR_VERSION = 1;
+
+static void putUInt64( unsigned char* buf, uint64_t val ){
+    for( int i = 0; i < 8; i++ )
+        buf[i] = (unsigned char)( val >> (8 * i) );
+}
+
+static uint64_t getUInt64( const unsigned char* buf ){
+    uint64_t val = 0;
+    for( int i = 0; i < 8; i++ )
+        val |= (uint64_t)buf[i] << (8 * i);
+    return val;
+}
+
+/*! Decodes one varint at 'pos', and moves the 'pos' after it.
+ *  @return false if encoding ends prematurely.
+ */
+static bool decodeVarint( const std::vector< unsigned char >& buf, size_t& pos, uint64_t& val ){
+    val = 0;
+    for( int shift = 0; pos < buf.size() && shift < 64; shift += 7 ){
+        unsigned char byte = buf[ pos++ ];
+        val |= (uint64_t)( byte & 0x7F ) << shift;
+        if( !(byte & 0x80) )
+            return true;
+    }
+    return false;
+}
+
+void LineIndex::clear(){
+    lineCount = 0;
+    fileSize = 0;
+    entryCount = 0;
+    lastOffset = 0;
+    deltas.clear();
+    anchors.clear();
+}
+
+/*! Appends the offset of the next indexed line. Every ANCHOR_INTERVAL-th
+ *  entry also gets an anchor - it's absolute offset and the position after
+ *  it's delta.
+ */
+void LineIndex::addEntry( uint64_t offset )
+{
+    uint64_t delta = offset - lastOffset;
+    while( delta >= 0x80 ){
+        deltas.push_back( (unsigned char)( (delta & 0x7F) | 0x80 ) );
+        delta >>= 7;
+    }
+    deltas.push_back( (unsigned char)delta );
+
+    if( entryCount % ANCHOR_INTERVAL == 0 )
+        anchors.push_back( Anchor{ deltas.size(), offset } );
+
+    lastOffset = offset;
+    entryCount++;
+}
+
+/*! Builds the index by reading all that's left in the reader. Offsets are
+ *  counted from reader's current position.
+ *  - Reader's windows are scanned in place, through the views.
+ */
+bool LineIndex::build( StackReader& rdr )
+{
+    clear();
+
+    uint64_t pos = 0, newlines = 0;
+    char lastChar = '\n';
+    StackReader::View view;
+
+    while( rdr.isReadable() && rdr.getView( view, rdr.currentLength() ) ){
+        const char* start = view.begin();
+        const char* end = view.end();
+
+        for( const char* p = start;
+             ( p = (const char*)std::memchr( p, '\n', end - p ) ) != nullptr; ){
+            ++p;
+            if( ++newlines % step == 0 )
+                addEntry( pos + (uint64_t)(p - start) );
+        }
+
+        pos += view.size();
+        lastChar = *(end - 1);
+        view.release();
+    }
+
+    fileSize = pos;
+    lineCount = newlines + ( lastChar != '\n' ? 1 : 0 );
+    return true;
+}
+
+bool LineIndex::build( const char* filePath )
+{
+    clear();
+#if defined _GRYLTOOL_POSIX
+    int fd = open( filePath, O_RDONLY );
+    if( fd < 0 )
+        return false;
+
+    bool ok;
+    {
+        StackReader rdr( fd );
+        ok = build( rdr );
+    }
+    close( fd );
+    return ok;
+#else
+    FILE* file = fopen( filePath, "rb" );
+    if( !file )
+        return false;
+
+    bool ok;
+    {
+        StackReader rdr( file );
+        ok = build( rdr );
+    }
+    fclose( file );
+    return ok;
+#endif
+}
+
+/*! Gets the offset of the nearest indexed line at or before 'line'.
+ *  @param line        - 0-based line number.
+ *  @param offset      - offset of the indexed line.
+ *  @param linesToSkip - lines to be scanned from it to reach the 'line'.
+ *  @return false if file has no such line.
+ */
+bool LineIndex::getLineOffset( uint64_t line, uint64_t& offset, size_t& linesToSkip ) const
+{
+    if( line >= lineCount && !( line == 0 && fileSize == 0 ) )
+        return false;
+
+    linesToSkip = (size_t)( line % step );
+    uint64_t entry = line / step;
+    if( !entry ){
+        offset = 0;
+        return true;
+    }
+
+    // Entry 'i' indexes line (i+1)*step.
+    entry--;
+    if( entry >= entryCount )
+        return false;
+
+    const Anchor& anchor = anchors[ entry / ANCHOR_INTERVAL ];
+    size_t pos = anchor.deltaPos;
+    offset = anchor.offset;
+
+    for( size_t i = entry % ANCHOR_INTERVAL; i > 0; i-- ){
+        uint64_t delta;
+        if( !decodeVarint( deltas, pos, delta ) )
+            return false;
+        offset += delta;
+    }
+    return true;
+}
+
+/*! Creates a reader on the source starting at the indexed line, and skips
+ *  the remaining lines.
+ */
+bool LineIndex::openLineAt( std::unique_ptr< ByteSource > src, size_t linesToSkip,
+                            std::unique_ptr< StackReader >& rdr ) const
+{
+    rdr.reset( new StackReader( std::move( src ) ) );
+
+    char c;
+    for( size_t i = 0; i < linesToSkip; i++ ){
+        if( !rdr->skipUntilChar( '\n' ) || !rdr->getChar( c ) )
+            return false;
+    }
+    return true;
+}
+
+#if defined _GRYLTOOL_POSIX
+
+/*! Opens a reader on the 'fd', positioned at the start of 'line'.
+ *  - Descriptor is read by pread(), so it's offset is not changed.
+ *  @return false if no such line, or file's size has changed.
+ */
+bool LineIndex::openLine( int fd, uint64_t line, std::unique_ptr< StackReader >& rdr ) const
+{
+    uint64_t offset;
+    size_t linesToSkip;
+    struct stat st;
+
+    if( !getLineOffset( line, offset, linesToSkip ) ||
+        fstat( fd, &st ) != 0 || (uint64_t)st.st_size != fileSize )
+        return false;
+
+    return openLineAt( std::unique_ptr< ByteSource >(
+                           new FdSource( fd, (off_t)offset, -1, false ) ),
+                       linesToSkip, rdr );
+}
+
+bool LineIndex::openLine( const char* filePath, uint64_t line, std::unique_ptr< StackReader >& rdr ) const
+{
+    int fd = open( filePath, O_RDONLY );
+    if( fd < 0 )
+        return false;
+
+    uint64_t offset;
+    size_t linesToSkip;
+    struct stat st;
+
+    if( !getLineOffset( line, offset, linesToSkip ) ||
+        fstat( fd, &st ) != 0 || (uint64_t)st.st_size != fileSize ){
+        close( fd );
+        return false;
+    }
+
+    return openLineAt( std::unique_ptr< ByteSource >(
+                           new FdSource( fd, (off_t)offset, -1, true ) ),
+                       linesToSkip, rdr );
+}
+
+#else
+
+bool LineIndex::openLine( const char* filePath, uint64_t line, std::unique_ptr< StackReader >& rdr ) const
+{
+    uint64_t offset;
+    size_t linesToSkip;
+    if( !getLineOffset( line, offset, linesToSkip ) )
+        return false;
+
+    FILE* file = fopen( filePath, "rb" );
+    if( !file )
+        return false;
+
+    if( fseek( file, 0, SEEK_END ) != 0 || (uint64_t)ftell( file ) != fileSize ||
+        fseek( file, (long)offset, SEEK_SET ) != 0 ){
+        fclose( file );
+        return false;
+    }
+
+    return openLineAt( std::unique_ptr< ByteSource >( new CFileSource( file, true ) ),
+                       linesToSkip, rdr );
+}
+
+#endif // _GRYLTOOL_POSIX
+
+/*! Writes the index to the sidecar file.
+ *  Format: "GLIX", version byte, then little-endian 64-bit step, line count,
+ *  file size, entry count, encoded size, and the encoded deltas.
+ */
+bool LineIndex::save( FILE* out ) const
+{
+    unsigned char header[ 5 + 5*8 ];
+    std::memcpy( header, SIDECAR_MAGIC, 4 );
+    header[4] = SIDECAR_VERSION;
+    putUInt64( header + 5, step );
+    putUInt64( header + 13, lineCount );
+    putUInt64( header + 21, fileSize );
+    putUInt64( header + 29, entryCount );
+    putUInt64( header + 37, deltas.size() );
+
+    if( fwrite( header, 1, sizeof(header), out ) != sizeof(header) )
+        return false;
+    if( !deltas.empty() && fwrite( deltas.data(), 1, deltas.size(), out ) != deltas.size() )
+        return false;
+    return fflush( out ) == 0;
+}
+
+bool LineIndex::save( const char* path ) const
+{
+    FILE* out = fopen( path, "wb" );
+    if( !out )
+        return false;
+
+    bool ok = save( out );
+    return ( fclose( out ) == 0 ) && ok;
+}
+
+/*! Reads the index from the sidecar file. The anchors are rebuilt by
+ *  decoding the deltas. File must be seekable - sizes in the header are
+ *  checked against what's left in it before anything is allocated.
+ *  @return false if file is not a valid index. Index is then empty.
+ */
+bool LineIndex::load( FILE* in )
+{
+    clear();
+
+    unsigned char header[ 5 + 5*8 ];
+    if( fread( header, 1, sizeof(header), in ) != sizeof(header) ||
+        std::memcmp( header, SIDECAR_MAGIC, 4 ) != 0 || header[4] != SIDECAR_VERSION )
+        return false;
+
+    uint64_t newStep = getUInt64( header + 5 );
+    uint64_t newLineCount = getUInt64( header + 13 );
+    uint64_t newFileSize = getUInt64( header + 21 );
+    uint64_t newEntryCount = getUInt64( header + 29 );
+    uint64_t encodedSize = getUInt64( header + 37 );
+
+    long here = ftell( in );
+    if( here < 0 || fseek( in, 0, SEEK_END ) != 0 )
+        return false;
+    long end = ftell( in );
+    if( end < here || fseek( in, here, SEEK_SET ) != 0 )
+        return false;
+
+    // Every delta takes 1 to 10 bytes. Sizes are bounded by the file's one
+    // first, so the multiplication can't overflow.
+    if( !newStep || encodedSize > (uint64_t)( end - here ) || newEntryCount > encodedSize ||
+        encodedSize > newEntryCount * 10 )
+        return false;
+
+    std::vector< unsigned char > encoded( (size_t)encodedSize );
+    if( encodedSize && fread( encoded.data(), 1, encoded.size(), in ) != encoded.size() )
+        return false;
+
+    // Re-add the entries, verifying the encoding.
+    step = (size_t)newStep;
+    size_t pos = 0;
+    uint64_t offset = 0;
+    for( uint64_t i = 0; i < newEntryCount; i++ ){
+        uint64_t delta;
+        if( !decodeVarint( encoded, pos, delta ) ){
+            clear();
+            return false;
+        }
+        offset += delta;
+        addEntry( offset );
+    }
+    if( pos != encoded.size() ){
+        clear();
+        return false;
+    }
+
+    lineCount = newLineCount;
+    fileSize = newFileSize;
+    return true;
+}
+
+bool LineIndex::load( const char* path )
+{
+    FILE* in = fopen( path, "rb" );
+    if( !in )
+        return false;
+
+    bool ok = load( in );
+    fclose( in );
+    return ok;
+}
+
+}
@@ -0,0 +1,72 @@
+#ifndef LINEINDEX_HPP_INCLUDED
+#define LINEINDEX_HPP_INCLUDED
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include "stackreader.hpp"
+
+namespace gtools{
+
+/*! Sparse index of line starts, for random line access on huge inputs.
+ *  - Built in one sequential pass, recording the offset of every 'step'-th
+ *    line. Line N is then reached by one seek, and scanning at most
+ *    'step' - 1 lines.
+ *  - Offsets are kept as varint-encoded deltas, with an absolute anchor
+ *    every ANCHOR_INTERVAL entries, so the lookup decodes only a few.
+ *  - Index can be saved to a sidecar file, and loaded later.
+ */
+class LineIndex{
+private:
+    size_t step;
+    uint64_t lineCount = 0;
+    uint64_t fileSize = 0;
+    uint64_t entryCount = 0;
+    uint64_t lastOffset = 0;
+
+    std::vector< unsigned char > deltas;
+
+    struct Anchor{
+        size_t deltaPos;
+        uint64_t offset;
+    };
+    std::vector< Anchor > anchors;
+
+    void clear();
+    void addEntry( uint64_t offset );
+    bool openLineAt( std::unique_ptr< ByteSource > src, size_t linesToSkip,
+                     std::unique_ptr< StackReader >& rdr ) const;
+
+public:
+    const static size_t DEFAULT_STEP = 1024;
+    const static size_t ANCHOR_INTERVAL = 64;
+
+    LineIndex( size_t step = DEFAULT_STEP ) : step( step ? step : 1 ) {}
+
+    bool build( StackReader& rdr );
+    bool build( const char* filePath );
+
+    size_t getStep() const { return step; }
+    uint64_t getLineCount() const { return lineCount; }
+    uint64_t getFileSize() const { return fileSize; }
+    size_t getEncodedSize() const { return deltas.size(); }
+
+    bool getLineOffset( uint64_t line, uint64_t& offset, size_t& linesToSkip ) const;
+
+    // Opens a reader positioned at the start of the line.
+    bool openLine( const char* filePath, uint64_t line, std::unique_ptr< StackReader >& rdr ) const;
+#if defined _GRYLTOOL_POSIX
+    bool openLine( int fd, uint64_t line, std::unique_ptr< StackReader >& rdr ) const;
+#endif
+
+    // Sidecar file.
+    bool save( FILE* out ) const;
+    bool save( const char* path ) const;
+    bool load( FILE* in );
+    bool load( const char* path );
+};
+
+}
+
+#endif // LINEINDEX_HPP_INCLUDED
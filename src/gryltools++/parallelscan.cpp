@@ -0,0 +1,96 @@
+#include <cstring>
+#include "parallelscan.hpp"
+
+#if defined _GRYLTOOL_POSIX
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace gtools{
+
+/*! Finds the offset right after the first newline at or after 'from'.
+ *  @return file's size if no newline is found.
+ */
+static uint64_t nextLineStart( int fd, uint64_t from, uint64_t fileSize )
+{
+    char buff[ ParallelScan::ALIGN_BLOCK ];
+    FdSource src( fd, (off_t)from, (off_t)(fileSize - from) );
+
+    long red;
+    while( (red = src.read( buff, sizeof(buff) )) > 0 ){
+        const char* nl = (const char*)std::memchr( buff, '\n', red );
+        if( nl )
+            return from + (uint64_t)(nl - buff) + 1;
+        from += red;
+    }
+    return fileSize;
+}
+
+/*! Splits the file into at most 'chunkCount' ranges of about equal size, 
+ *  each starting at a line start. Empty ranges are dropped.
+ *  @return false if file's size can't be determined.
+ */
+bool ParallelScan::splitFile( int fd, size_t chunkCount, std::vector< ScanChunk >& chunks )
+{
+    chunks.clear();
+
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || st.st_size < 0 )
+        return false;
+
+    uint64_t fileSize = (uint64_t)st.st_size;
+    if( !chunkCount )
+        chunkCount = 1;
+
+    uint64_t start = 0;
+    for( size_t i = 1; i <= chunkCount && start < fileSize; i++ ){
+        uint64_t end = fileSize;
+        if( i < chunkCount ){
+            // Chunk ends after the line containing the approximate boundary.
+            uint64_t boundary = fileSize / chunkCount * i;
+            end = ( boundary <= start ? start : boundary - 1 );
+            end = nextLineStart( fd, end, fileSize );
+        }
+
+        if( end > start )
+            chunks.emplace_back( chunks.size(), start, end - start );
+        start = end;
+    }
+    return true;
+}
+
+/*! Sets chunks' first line numbers by the prefix sum of their newlines.
+ */
+void ParallelScan::numberLines( std::vector< ScanChunk >& chunks )
+{
+    uint64_t line = 0;
+    for( auto& chunk : chunks ){
+        chunk.firstLine = line;
+        line += chunk.endlines;
+    }
+}
+
+size_t ParallelScan::getDefaultThreadCount()
+{
+    size_t cnt = std::thread::hardware_concurrency();
+    return ( cnt ? cnt : 1 );
+}
+
+/*! Creates a reader on the chunk's range - in place if file is mapped.
+ */
+std::unique_ptr< StackReader > ParallelScan::openChunk( int fd, const MappedFileSource* mapping,
+                                                        const ScanChunk& chunk )
+{
+    std::unique_ptr< ByteSource > src;
+    if( mapping )
+        src.reset( new MemorySource( mapping->getData() + chunk.offset, (size_t)chunk.length ) );
+    else
+        src.reset( new FdSource( fd, (off_t)chunk.offset, (off_t)chunk.length ) );
+
+    return std::unique_ptr< StackReader >( new StackReader( std::move( src ), 
+                StackReader::DEFAULT_PRIORITY_STACK, DEFAULT_READBUFFER ) );
+}
+
+}
+
+#endif // _GRYLTOOL_POSIX
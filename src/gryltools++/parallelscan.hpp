@@ -0,0 +1,114 @@
+#ifndef PARALLELSCAN_HPP_INCLUDED
+#define PARALLELSCAN_HPP_INCLUDED
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include "stackreader.hpp"
+#include "systemcheck.h"
+
+#if defined _GRYLTOOL_POSIX
+
+/*! Parallel scanning of a single large file.
+ *  - File is split into byte ranges, each starting right after a newline,
+ *    and each range is scanned by it's own StackReader on a worker thread.
+ *  - Mapped files are scanned in place. Others are read by pread(), so the
+ *    descriptor is shared between the workers.
+ *  - Per-chunk results are kept in file order, and each chunk gets it's
+ *    global first line number by a prefix sum of the chunks' 'endlines'.
+ */
+
+namespace gtools{
+
+struct ScanChunk{
+    size_t index;
+    uint64_t offset;
+    uint64_t length;
+
+    // Set by the scanning function - count of newlines in the chunk.
+    size_t endlines = 0;
+
+    // Set after all chunks are scanned - global number of the chunk's first line.
+    uint64_t firstLine = 0;
+
+    ScanChunk( size_t index, uint64_t offset, uint64_t length )
+        : index( index ), offset( offset ), length( length ) {}
+};
+
+class ParallelScan{
+public:
+    const static size_t DEFAULT_READBUFFER = 64 * 1024;
+    const static size_t ALIGN_BLOCK = 4096;
+
+    static bool splitFile( int fd, size_t chunkCount, std::vector< ScanChunk >& chunks );
+    static void numberLines( std::vector< ScanChunk >& chunks );
+    static size_t getDefaultThreadCount();
+
+    template< typename Result >
+    static bool scan( int fd, std::function< void( StackReader&, ScanChunk&, Result& ) > scanFunc,
+                      std::vector< ScanChunk >& chunks, std::vector< Result >& results,
+                      size_t threadCount = 0, size_t chunkCount = 0 );
+
+private:
+    static std::unique_ptr< StackReader > openChunk( int fd, const MappedFileSource* mapping,
+                                                     const ScanChunk& chunk );
+};
+
+/*! Scans the file on 'threadCount' workers (hardware concurrency if 0).
+ *  @param scanFunc   - called for every chunk with a reader on it's range. Must
+ *                      set chunk's 'endlines' for the line numbering.
+ *  @param chunks     - file's chunks, in file order, numbered after the scan.
+ *  @param results    - result of every chunk, in file order.
+ *                      Result must not be bool (std::vector<bool> is packed).
+ *  @param chunkCount - count of chunks to split to. Default is 'threadCount'.
+ *  @return false if the file couldn't be split.
+ */
+template< typename Result >
+bool ParallelScan::scan( int fd, std::function< void( StackReader&, ScanChunk&, Result& ) > scanFunc,
+                         std::vector< ScanChunk >& chunks, std::vector< Result >& results,
+                         size_t threadCount, size_t chunkCount )
+{
+    if( !threadCount )
+        threadCount = getDefaultThreadCount();
+    if( !chunkCount )
+        chunkCount = threadCount;
+
+    if( !splitFile( fd, chunkCount, chunks ) )
+        return false;
+
+    results.clear();
+    results.resize( chunks.size() );
+
+    std::unique_ptr< MappedFileSource > mapping( new MappedFileSource( fd ) );
+    if( !mapping->isMapped() )
+        mapping.reset();
+
+    std::atomic< size_t > nextChunk( 0 );
+
+    auto worker = [&](){
+        size_t i;
+        while( (i = nextChunk++) < chunks.size() ){
+            std::unique_ptr< StackReader > rdr = openChunk( fd, mapping.get(), chunks[i] );
+            scanFunc( *rdr, chunks[i], results[i] );
+        }
+    };
+
+    std::vector< std::thread > workers;
+    for( size_t i = 1; i < threadCount && i < chunks.size(); i++ )
+        workers.emplace_back( worker );
+    worker();
+
+    for( auto& thr : workers )
+        thr.join();
+
+    numberLines( chunks );
+    return true;
+}
+
+}
+
+#endif // _GRYLTOOL_POSIX
+
+#endif // PARALLELSCAN_HPP_INCLUDED
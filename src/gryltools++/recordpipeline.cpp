@@ -0,0 +1,31 @@
+#include "recordpipeline.hpp"
+
+namespace gtools{
+
+/*! Reads the next batch - 'batchSize' bytes, and the rest of the record cut
+ *  by it, with the delimiter.
+ *  @return false if input has ended.
+ */
+bool RecordPipeline::readBatch( StackReader& reader, RecordBatch& batch,
+                                size_t batchSize, char delimiter )
+{
+    std::string& data = batch.data;
+    data.resize( batchSize ? batchSize : 1 );
+    data.resize( reader.getString( &data[0], data.size() ) );
+    if( data.empty() )
+        return false;
+
+    char c;
+    if( data.back() != delimiter && reader.getStringUntilDelim( data, CharSet( delimiter ) ) &&
+        reader.getChar( c ) )
+        data += c;
+    return true;
+}
+
+size_t RecordPipeline::getDefaultThreadCount()
+{
+    size_t cnt = std::thread::hardware_concurrency();
+    return ( cnt ? cnt : 1 );
+}
+
+}
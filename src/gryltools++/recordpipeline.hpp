@@ -0,0 +1,145 @@
+#ifndef RECORDPIPELINE_HPP_INCLUDED
+#define RECORDPIPELINE_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <functional>
+#include "stackreader.hpp"
+#include "blockingqueue.hpp"
+
+/*! Record parsing spread over the worker threads.
+ *  - Calling thread reads the input by the StackReader, and splits it into
+ *    batches of whole records - about 'batchSize' bytes, ending after the
+ *    delimiter.
+ *  - Batches are passed by the BlockingQueue to the parsing workers, and
+ *    their results to one merging thread, in input order if requested.
+ *  - Batches and their results are reused from a fixed pool, so the memory
+ *    stays bounded however far the reader gets ahead.
+ */
+
+namespace gtools{
+
+struct RecordBatch{
+    // Position of the batch in the input, from 0.
+    size_t index = 0;
+
+    // Whole records, each ending with the delimiter. Only the last record
+    // of the input may end without it.
+    std::string data;
+};
+
+class RecordPipeline{
+public:
+    const static size_t DEFAULT_BATCH_SIZE = 64 * 1024;
+
+    static bool readBatch( StackReader& reader, RecordBatch& batch,
+                           size_t batchSize = DEFAULT_BATCH_SIZE, char delimiter = '\n' );
+    static size_t getDefaultThreadCount();
+
+    template< typename Result >
+    static size_t run( StackReader& reader,
+                       std::function< void( const RecordBatch&, Result& ) > parseFunc,
+                       std::function< void( const RecordBatch&, Result& ) > mergeFunc,
+                       bool ordered = true, size_t threadCount = 0,
+                       size_t batchSize = DEFAULT_BATCH_SIZE, char delimiter = '\n' );
+};
+
+/*! Reads the input to the end, parsing it on 'threadCount' workers (hardware
+ *  concurrency if 0). Not for the non-blocking sources.
+ *  @param parseFunc - called on the worker threads, for every batch with it's
+ *                     own result, reset to Result() before.
+ *  @param mergeFunc - called on one thread, for every parsed batch - in input
+ *                     order if 'ordered'. May be empty, then no merging is done.
+ *  @return count of the batches read.
+ */
+template< typename Result >
+size_t RecordPipeline::run( StackReader& reader,
+                            std::function< void( const RecordBatch&, Result& ) > parseFunc,
+                            std::function< void( const RecordBatch&, Result& ) > mergeFunc,
+                            bool ordered, size_t threadCount, size_t batchSize, char delimiter )
+{
+    struct Slot{
+        RecordBatch batch;
+        Result result;
+    };
+
+    if( !threadCount )
+        threadCount = getDefaultThreadCount();
+
+    // Enough slots for every worker to have one while the others are queued.
+    const size_t slotCount = 2 * threadCount + 2;
+    std::vector< std::unique_ptr< Slot > > slots;
+    BlockingQueue< Slot* > freeSlots, filledSlots, parsedSlots;
+    for( size_t i = 0; i < slotCount; i++ ){
+        slots.emplace_back( new Slot() );
+        freeSlots.push( slots.back().get() );
+    }
+
+    // Null slot is the end marker.
+    std::vector< std::thread > workers;
+    for( size_t i = 0; i < threadCount; i++ ){
+        workers.emplace_back( [&](){
+            Slot* slot;
+            while( (slot = filledSlots.pop()) != nullptr ){
+                slot->result = Result();
+                parseFunc( slot->batch, slot->result );
+                if( mergeFunc )
+                    parsedSlots.push( slot );
+                else
+                    freeSlots.push( slot );
+            }
+        } );
+    }
+
+    // Slots in flight are never more than 'slotCount' batches after the
+    // next one to merge - waiting ones are kept in a ring by the index.
+    std::thread merger;
+    if( mergeFunc ){
+        merger = std::thread( [&](){
+            std::vector< Slot* > pending( slotCount, nullptr );
+            size_t next = 0;
+            Slot* slot;
+            while( (slot = parsedSlots.pop()) != nullptr ){
+                if( !ordered ){
+                    mergeFunc( slot->batch, slot->result );
+                    freeSlots.push( slot );
+                    continue;
+                }
+
+                pending[ slot->batch.index % slotCount ] = slot;
+                while( (slot = pending[ next % slotCount ]) != nullptr ){
+                    pending[ next % slotCount ] = nullptr;
+                    mergeFunc( slot->batch, slot->result );
+                    freeSlots.push( slot );
+                    next++;
+                }
+            }
+        } );
+    }
+
+    size_t batchCount = 0;
+    while(1){
+        Slot* slot = freeSlots.pop();
+        if( !readBatch( reader, slot->batch, batchSize, delimiter ) )
+            break;
+        slot->batch.index = batchCount++;
+        filledSlots.push( slot );
+    }
+
+    for( size_t i = 0; i < workers.size(); i++ )
+        filledSlots.push( nullptr );
+    for( auto& thr : workers )
+        thr.join();
+
+    if( merger.joinable() ){
+        parsedSlots.push( nullptr );
+        merger.join();
+    }
+    return batchCount;
+}
+
+}
+
+#endif // RECORDPIPELINE_HPP_INCLUDED
@@ -0,0 +1,816 @@
+#include "scantools.hpp"
+#include <cstring>
+#include <string>
+#include <sstream>
+#include <locale>
+
+#if ( defined(__x86_64__) || defined(__i386__) ) && defined(__GNUC__)
+    #define GTOOLS_SCAN_X86
+    #include <immintrin.h>
+#endif
+
+namespace gtools{
+
+namespace ScanTools{
+
+/*! Scalar kernels. Also used for the tails shorter than a vector.
+ */ 
+static const char* skipWhitespaceScalar( const char* p, const char* end, bool stopAtNewline,
+                                         size_t& newlines, const char*& lastNewline )
+{
+    for( ; p < end; p++ ){
+        if( *p == '\n' ){
+            if( stopAtNewline )
+                return p;
+            ++newlines;
+            lastNewline = p;
+        }
+        else if( !isSpace( *p ) )
+            return p;
+    }
+    return p;
+}
+
+static const char* skipWhitespaceUncountedScalar( const char* p, const char* end, bool stopAtNewline )
+{
+    for( ; p < end; p++ ){
+        if( !isSpace( *p ) || ( stopAtNewline && *p == '\n' ) )
+            return p;
+    }
+    return p;
+}
+
+static const char* findFirstOfScalar( const char* p, const char* end, 
+                                      const char* chars, size_t count )
+{
+    for( ; p < end; p++ ){
+        for( size_t i = 0; i < count; i++ ){
+            if( *p == chars[i] )
+                return p;
+        }
+    }
+    return p;
+}
+
+static size_t countNewlinesScalar( const char* p, const char* end, const char*& lastNewline )
+{
+    size_t cnt = 0;
+    for( ; p < end; p++ ){
+        if( *p == '\n' ){
+            ++cnt;
+            lastNewline = p;
+        }
+    }
+    return cnt;
+}
+
+static const char* findNonAsciiScalar( const char* p, const char* end )
+{
+    for( ; p < end; p++ ){
+        if( (unsigned char)*p >= 0x80 )
+            return p;
+    }
+    return p;
+}
+
+static size_t countCodepointsScalar( const char* p, const char* end )
+{
+    size_t cnt = 0;
+    for( ; p < end; p++ )
+        cnt += ( ((unsigned char)*p & 0xC0) != 0x80 );
+    return cnt;
+}
+
+/*! Bit i of the result is the XOR of the bits 0..i - set for the bytes after
+ *  an odd number of quotes.
+ */ 
+static inline uint64_t prefixXor( uint64_t bits )
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+/*! Handles the classified block of 'len' (up to 64) bytes at 'offset'.
+ */ 
+static inline void delimitedBlock( uint64_t quotes, uint64_t structural, size_t len, 
+                                   bool& inQuotes, std::vector< size_t >& structurals, 
+                                   size_t offset )
+{
+    uint64_t valid = ( len < 64 ? ( (uint64_t)1 << len ) - 1 : ~(uint64_t)0 );
+    uint64_t quoted = prefixXor( quotes & valid ) ^ ( inQuotes ? ~(uint64_t)0 : 0 );
+    inQuotes = ( quoted >> ( len - 1 ) ) & 1;
+
+    for( structural &= valid & ~quoted; structural; structural &= structural - 1 )
+        structurals.push_back( offset + (size_t)__builtin_ctzll( structural ) );
+}
+
+static void indexDelimitedScalar( const char* p, const char* end, char delimiter, char quote,
+                                  bool& inQuotes, std::vector< size_t >& structurals, size_t base )
+{
+    for( const char* start = p; p < end; ){
+        size_t len = ( end - p < 64 ? (size_t)(end - p) : 64 );
+        uint64_t quotes = 0, structural = 0;
+        for( size_t i = 0; i < len; i++ ){
+            quotes     |= (uint64_t)( p[i] == quote ) << i;
+            structural |= (uint64_t)( p[i] == delimiter || p[i] == '\n' ) << i;
+        }
+
+        delimitedBlock( quotes, structural, len, inQuotes, structurals, base + (size_t)(p - start) );
+        p += len;
+    }
+}
+
+#ifdef GTOOLS_SCAN_X86
+
+/*! Accounts newlines marked by 'nlMask' bits, relative to 'base'.
+ */ 
+static inline void countMaskedNewlines( const char* base, unsigned nlMask, 
+                            size_t& newlines, const char*& lastNewline )
+{
+    if( nlMask ){
+        newlines += __builtin_popcount( nlMask );
+        lastNewline = base + ( 31 - __builtin_clz( nlMask ) );
+    }
+}
+
+__attribute__(( target("sse2") ))
+static const char* skipWhitespaceSSE2( const char* p, const char* end, bool stopAtNewline,
+                                       size_t& newlines, const char*& lastNewline )
+{
+    const __m128i spaces = _mm_set1_epi8( ' ' );
+    const __m128i tabs   = _mm_set1_epi8( '\t' );
+    const __m128i ctlMax = _mm_set1_epi8( '\r' - '\t' );
+    const __m128i endls  = _mm_set1_epi8( '\n' );
+
+    for( ; end - p >= 16; p += 16 ){
+        __m128i v = _mm_loadu_si128( (const __m128i*)p );
+
+        // '\t'..'\r' are checked as (c - '\t') <= 4, unsigned.
+        __m128i ctl = _mm_sub_epi8( v, tabs );
+        ctl = _mm_cmpeq_epi8( _mm_min_epu8( ctl, ctlMax ), ctl );
+        __m128i ws = _mm_or_si128( ctl, _mm_cmpeq_epi8( v, spaces ) );
+
+        unsigned nlMask = (unsigned)_mm_movemask_epi8( _mm_cmpeq_epi8( v, endls ) );
+        unsigned stop = ~(unsigned)_mm_movemask_epi8( ws ) & 0xFFFFu;
+        if( stopAtNewline )
+            stop |= nlMask;
+
+        if( stop ){
+            unsigned idx = __builtin_ctz( stop );
+            countMaskedNewlines( p, nlMask & ((1u << idx) - 1), newlines, lastNewline );
+            return p + idx;
+        }
+        countMaskedNewlines( p, nlMask, newlines, lastNewline );
+    }
+    return skipWhitespaceScalar( p, end, stopAtNewline, newlines, lastNewline );
+}
+
+__attribute__(( target("sse2") ))
+static const char* skipWhitespaceUncountedSSE2( const char* p, const char* end, bool stopAtNewline )
+{
+    const __m128i spaces = _mm_set1_epi8( ' ' );
+    const __m128i tabs   = _mm_set1_epi8( '\t' );
+    const __m128i ctlMax = _mm_set1_epi8( '\r' - '\t' );
+    const __m128i endls  = _mm_set1_epi8( '\n' );
+
+    for( ; end - p >= 16; p += 16 ){
+        __m128i v = _mm_loadu_si128( (const __m128i*)p );
+
+        __m128i ctl = _mm_sub_epi8( v, tabs );
+        ctl = _mm_cmpeq_epi8( _mm_min_epu8( ctl, ctlMax ), ctl );
+        __m128i ws = _mm_or_si128( ctl, _mm_cmpeq_epi8( v, spaces ) );
+
+        unsigned stop = ~(unsigned)_mm_movemask_epi8( ws ) & 0xFFFFu;
+        if( stopAtNewline )
+            stop |= (unsigned)_mm_movemask_epi8( _mm_cmpeq_epi8( v, endls ) );
+        if( stop )
+            return p + __builtin_ctz( stop );
+    }
+    return skipWhitespaceUncountedScalar( p, end, stopAtNewline );
+}
+
+__attribute__(( target("avx2") ))
+static const char* skipWhitespaceAVX2( const char* p, const char* end, bool stopAtNewline,
+                                       size_t& newlines, const char*& lastNewline )
+{
+    const __m256i spaces = _mm256_set1_epi8( ' ' );
+    const __m256i tabs   = _mm256_set1_epi8( '\t' );
+    const __m256i ctlMax = _mm256_set1_epi8( '\r' - '\t' );
+    const __m256i endls  = _mm256_set1_epi8( '\n' );
+
+    for( ; end - p >= 32; p += 32 ){
+        __m256i v = _mm256_loadu_si256( (const __m256i*)p );
+
+        __m256i ctl = _mm256_sub_epi8( v, tabs );
+        ctl = _mm256_cmpeq_epi8( _mm256_min_epu8( ctl, ctlMax ), ctl );
+        __m256i ws = _mm256_or_si256( ctl, _mm256_cmpeq_epi8( v, spaces ) );
+
+        unsigned nlMask = (unsigned)_mm256_movemask_epi8( _mm256_cmpeq_epi8( v, endls ) );
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8( ws );
+        if( stopAtNewline )
+            stop |= nlMask;
+
+        if( stop ){
+            unsigned idx = __builtin_ctz( stop );
+            unsigned below = ( idx ? nlMask & (0xFFFFFFFFu >> (32 - idx)) : 0 );
+            countMaskedNewlines( p, below, newlines, lastNewline );
+            return p + idx;
+        }
+        countMaskedNewlines( p, nlMask, newlines, lastNewline );
+    }
+    return skipWhitespaceSSE2( p, end, stopAtNewline, newlines, lastNewline );
+}
+
+__attribute__(( target("avx2") ))
+static const char* skipWhitespaceUncountedAVX2( const char* p, const char* end, bool stopAtNewline )
+{
+    const __m256i spaces = _mm256_set1_epi8( ' ' );
+    const __m256i tabs   = _mm256_set1_epi8( '\t' );
+    const __m256i ctlMax = _mm256_set1_epi8( '\r' - '\t' );
+    const __m256i endls  = _mm256_set1_epi8( '\n' );
+
+    for( ; end - p >= 32; p += 32 ){
+        __m256i v = _mm256_loadu_si256( (const __m256i*)p );
+
+        __m256i ctl = _mm256_sub_epi8( v, tabs );
+        ctl = _mm256_cmpeq_epi8( _mm256_min_epu8( ctl, ctlMax ), ctl );
+        __m256i ws = _mm256_or_si256( ctl, _mm256_cmpeq_epi8( v, spaces ) );
+
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8( ws );
+        if( stopAtNewline )
+            stop |= (unsigned)_mm256_movemask_epi8( _mm256_cmpeq_epi8( v, endls ) );
+        if( stop )
+            return p + __builtin_ctz( stop );
+    }
+    return skipWhitespaceUncountedSSE2( p, end, stopAtNewline );
+}
+
+/*! Small-set search - compares each vector to up to 4 broadcasted chars.
+ *  Unused slots are filled with the first char.
+ */ 
+__attribute__(( target("sse2") ))
+static const char* findFirstOfSSE2( const char* p, const char* end, 
+                                    const char* chars, size_t count )
+{
+    const __m128i c0 = _mm_set1_epi8( chars[0] );
+    const __m128i c1 = _mm_set1_epi8( chars[ count > 1 ? 1 : 0 ] );
+    const __m128i c2 = _mm_set1_epi8( chars[ count > 2 ? 2 : 0 ] );
+    const __m128i c3 = _mm_set1_epi8( chars[ count > 3 ? 3 : 0 ] );
+
+    for( ; end - p >= 16; p += 16 ){
+        __m128i v = _mm_loadu_si128( (const __m128i*)p );
+        __m128i m = _mm_or_si128( 
+            _mm_or_si128( _mm_cmpeq_epi8( v, c0 ), _mm_cmpeq_epi8( v, c1 ) ),
+            _mm_or_si128( _mm_cmpeq_epi8( v, c2 ), _mm_cmpeq_epi8( v, c3 ) ) );
+
+        unsigned mask = (unsigned)_mm_movemask_epi8( m );
+        if( mask )
+            return p + __builtin_ctz( mask );
+    }
+    return findFirstOfScalar( p, end, chars, count );
+}
+
+__attribute__(( target("avx2") ))
+static const char* findFirstOfAVX2( const char* p, const char* end, 
+                                    const char* chars, size_t count )
+{
+    const __m256i c0 = _mm256_set1_epi8( chars[0] );
+    const __m256i c1 = _mm256_set1_epi8( chars[ count > 1 ? 1 : 0 ] );
+    const __m256i c2 = _mm256_set1_epi8( chars[ count > 2 ? 2 : 0 ] );
+    const __m256i c3 = _mm256_set1_epi8( chars[ count > 3 ? 3 : 0 ] );
+
+    for( ; end - p >= 32; p += 32 ){
+        __m256i v = _mm256_loadu_si256( (const __m256i*)p );
+        __m256i m = _mm256_or_si256( 
+            _mm256_or_si256( _mm256_cmpeq_epi8( v, c0 ), _mm256_cmpeq_epi8( v, c1 ) ),
+            _mm256_or_si256( _mm256_cmpeq_epi8( v, c2 ), _mm256_cmpeq_epi8( v, c3 ) ) );
+
+        unsigned mask = (unsigned)_mm256_movemask_epi8( m );
+        if( mask )
+            return p + __builtin_ctz( mask );
+    }
+    return findFirstOfSSE2( p, end, chars, count );
+}
+
+__attribute__(( target("sse2") ))
+static size_t countNewlinesSSE2( const char* p, const char* end, const char*& lastNewline )
+{
+    const __m128i endls = _mm_set1_epi8( '\n' );
+    size_t cnt = 0;
+
+    for( ; end - p >= 16; p += 16 ){
+        __m128i v = _mm_loadu_si128( (const __m128i*)p );
+        unsigned nlMask = (unsigned)_mm_movemask_epi8( _mm_cmpeq_epi8( v, endls ) );
+        countMaskedNewlines( p, nlMask, cnt, lastNewline );
+    }
+    return cnt + countNewlinesScalar( p, end, lastNewline );
+}
+
+__attribute__(( target("avx2,popcnt") ))
+static size_t countNewlinesAVX2( const char* p, const char* end, const char*& lastNewline )
+{
+    const __m256i endls = _mm256_set1_epi8( '\n' );
+    size_t cnt = 0;
+
+    for( ; end - p >= 32; p += 32 ){
+        __m256i v = _mm256_loadu_si256( (const __m256i*)p );
+        unsigned nlMask = (unsigned)_mm256_movemask_epi8( _mm256_cmpeq_epi8( v, endls ) );
+        if( nlMask ){
+            cnt += __builtin_popcount( nlMask );
+            lastNewline = p + ( 31 - __builtin_clz( nlMask ) );
+        }
+    }
+    return cnt + countNewlinesSSE2( p, end, lastNewline );
+}
+
+/*! ASCII bytes have the top bit clear, so movemask gives the non-ASCII ones.
+ */ 
+__attribute__(( target("sse2") ))
+static const char* findNonAsciiSSE2( const char* p, const char* end )
+{
+    for( ; end - p >= 16; p += 16 ){
+        unsigned mask = (unsigned)_mm_movemask_epi8( _mm_loadu_si128( (const __m128i*)p ) );
+        if( mask )
+            return p + __builtin_ctz( mask );
+    }
+    return findNonAsciiScalar( p, end );
+}
+
+__attribute__(( target("avx2") ))
+static const char* findNonAsciiAVX2( const char* p, const char* end )
+{
+    for( ; end - p >= 32; p += 32 ){
+        unsigned mask = (unsigned)_mm256_movemask_epi8( _mm256_loadu_si256( (const __m256i*)p ) );
+        if( mask )
+            return p + __builtin_ctz( mask );
+    }
+    return findNonAsciiSSE2( p, end );
+}
+
+/*! Continuation bytes are 0x80..0xBF, which is -128..-65 as signed - all
+ *  the others are greater than -65.
+ */ 
+__attribute__(( target("sse2") ))
+static size_t countCodepointsSSE2( const char* p, const char* end )
+{
+    const __m128i contMax = _mm_set1_epi8( -65 );
+    size_t cnt = 0;
+
+    for( ; end - p >= 16; p += 16 ){
+        __m128i v = _mm_loadu_si128( (const __m128i*)p );
+        unsigned mask = (unsigned)_mm_movemask_epi8( _mm_cmpgt_epi8( v, contMax ) );
+        cnt += __builtin_popcount( mask );
+    }
+    return cnt + countCodepointsScalar( p, end );
+}
+
+__attribute__(( target("avx2,popcnt") ))
+static size_t countCodepointsAVX2( const char* p, const char* end )
+{
+    const __m256i contMax = _mm256_set1_epi8( -65 );
+    size_t cnt = 0;
+
+    for( ; end - p >= 32; p += 32 ){
+        __m256i v = _mm256_loadu_si256( (const __m256i*)p );
+        unsigned mask = (unsigned)_mm256_movemask_epi8( _mm256_cmpgt_epi8( v, contMax ) );
+        cnt += __builtin_popcount( mask );
+    }
+    return cnt + countCodepointsSSE2( p, end );
+}
+
+/*! Blocks are classified by 64 bytes, the tail is copied to a padded one.
+ */ 
+__attribute__(( target("sse2") ))
+static void indexDelimitedSSE2( const char* p, const char* end, char delimiter, char quote,
+                                bool& inQuotes, std::vector< size_t >& structurals, size_t base )
+{
+    const __m128i delimV = _mm_set1_epi8( delimiter );
+    const __m128i quoteV = _mm_set1_epi8( quote );
+    const __m128i endlV = _mm_set1_epi8( '\n' );
+    char tail[ 64 ];
+
+    for( const char* start = p; p < end; ){
+        const char* block = p;
+        size_t len = 64;
+        if( end - p < 64 ){
+            len = (size_t)(end - p);
+            std::memset( tail, 0, sizeof( tail ) );
+            std::memcpy( tail, p, len );
+            block = tail;
+        }
+
+        uint64_t quotes = 0, structural = 0;
+        for( int i = 0; i < 4; i++ ){
+            __m128i v = _mm_loadu_si128( (const __m128i*)( block + 16 * i ) );
+            __m128i s = _mm_or_si128( _mm_cmpeq_epi8( v, delimV ), _mm_cmpeq_epi8( v, endlV ) );
+            quotes     |= (uint64_t)(unsigned)_mm_movemask_epi8( _mm_cmpeq_epi8( v, quoteV ) ) << ( 16 * i );
+            structural |= (uint64_t)(unsigned)_mm_movemask_epi8( s ) << ( 16 * i );
+        }
+
+        delimitedBlock( quotes, structural, len, inQuotes, structurals, base + (size_t)(p - start) );
+        p += len;
+    }
+}
+
+__attribute__(( target("avx2") ))
+static void indexDelimitedAVX2( const char* p, const char* end, char delimiter, char quote,
+                                bool& inQuotes, std::vector< size_t >& structurals, size_t base )
+{
+    const __m256i delimV = _mm256_set1_epi8( delimiter );
+    const __m256i quoteV = _mm256_set1_epi8( quote );
+    const __m256i endlV = _mm256_set1_epi8( '\n' );
+    char tail[ 64 ];
+
+    for( const char* start = p; p < end; ){
+        const char* block = p;
+        size_t len = 64;
+        if( end - p < 64 ){
+            len = (size_t)(end - p);
+            std::memset( tail, 0, sizeof( tail ) );
+            std::memcpy( tail, p, len );
+            block = tail;
+        }
+
+        __m256i lo = _mm256_loadu_si256( (const __m256i*)block );
+        __m256i hi = _mm256_loadu_si256( (const __m256i*)( block + 32 ) );
+        __m256i sLo = _mm256_or_si256( _mm256_cmpeq_epi8( lo, delimV ), _mm256_cmpeq_epi8( lo, endlV ) );
+        __m256i sHi = _mm256_or_si256( _mm256_cmpeq_epi8( hi, delimV ), _mm256_cmpeq_epi8( hi, endlV ) );
+        uint64_t quotes = (uint64_t)(unsigned)_mm256_movemask_epi8( _mm256_cmpeq_epi8( lo, quoteV ) ) |
+                          (uint64_t)(unsigned)_mm256_movemask_epi8( _mm256_cmpeq_epi8( hi, quoteV ) ) << 32;
+        uint64_t structural = (uint64_t)(unsigned)_mm256_movemask_epi8( sLo ) |
+                              (uint64_t)(unsigned)_mm256_movemask_epi8( sHi ) << 32;
+
+        delimitedBlock( quotes, structural, len, inQuotes, structurals, base + (size_t)(p - start) );
+        p += len;
+    }
+}
+
+#endif // GTOOLS_SCAN_X86
+
+/*! Runtime dispatch - picks the widest kernel supported by the CPU.
+ */ 
+typedef const char* (*SkipWhitespaceFunc)( const char*, const char*, bool, 
+                                           size_t&, const char*& );
+
+static SkipWhitespaceFunc selectSkipWhitespace()
+{
+#ifdef GTOOLS_SCAN_X86
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx2" ) )
+        return skipWhitespaceAVX2;
+    if( __builtin_cpu_supports( "sse2" ) )
+        return skipWhitespaceSSE2;
+#endif
+    return skipWhitespaceScalar;
+}
+
+typedef const char* (*SkipWhitespaceUncountedFunc)( const char*, const char*, bool );
+
+static SkipWhitespaceUncountedFunc selectSkipWhitespaceUncounted()
+{
+#ifdef GTOOLS_SCAN_X86
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx2" ) )
+        return skipWhitespaceUncountedAVX2;
+    if( __builtin_cpu_supports( "sse2" ) )
+        return skipWhitespaceUncountedSSE2;
+#endif
+    return skipWhitespaceUncountedScalar;
+}
+
+typedef const char* (*FindFirstOfFunc)( const char*, const char*, const char*, size_t );
+
+static FindFirstOfFunc selectFindFirstOf()
+{
+#ifdef GTOOLS_SCAN_X86
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx2" ) )
+        return findFirstOfAVX2;
+    if( __builtin_cpu_supports( "sse2" ) )
+        return findFirstOfSSE2;
+#endif
+    return findFirstOfScalar;
+}
+
+typedef size_t (*CountNewlinesFunc)( const char*, const char*, const char*& );
+
+static CountNewlinesFunc selectCountNewlines()
+{
+#ifdef GTOOLS_SCAN_X86
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx2" ) )
+        return countNewlinesAVX2;
+    if( __builtin_cpu_supports( "sse2" ) )
+        return countNewlinesSSE2;
+#endif
+    return countNewlinesScalar;
+}
+
+typedef const char* (*FindNonAsciiFunc)( const char*, const char* );
+
+static FindNonAsciiFunc selectFindNonAscii()
+{
+#ifdef GTOOLS_SCAN_X86
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx2" ) )
+        return findNonAsciiAVX2;
+    if( __builtin_cpu_supports( "sse2" ) )
+        return findNonAsciiSSE2;
+#endif
+    return findNonAsciiScalar;
+}
+
+typedef size_t (*CountCodepointsFunc)( const char*, const char* );
+
+static CountCodepointsFunc selectCountCodepoints()
+{
+#ifdef GTOOLS_SCAN_X86
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx2" ) )
+        return countCodepointsAVX2;
+    if( __builtin_cpu_supports( "sse2" ) )
+        return countCodepointsSSE2;
+#endif
+    return countCodepointsScalar;
+}
+
+typedef void (*IndexDelimitedFunc)( const char*, const char*, char, char, 
+                                    bool&, std::vector< size_t >&, size_t );
+
+static IndexDelimitedFunc selectIndexDelimited()
+{
+#ifdef GTOOLS_SCAN_X86
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx2" ) )
+        return indexDelimitedAVX2;
+    if( __builtin_cpu_supports( "sse2" ) )
+        return indexDelimitedSSE2;
+#endif
+    return indexDelimitedScalar;
+}
+
+const char* skipWhitespace( const char* begin, const char* end, bool stopAtNewline,
+                            size_t& newlines, const char*& lastNewline )
+{
+    static const SkipWhitespaceFunc impl = selectSkipWhitespace();
+    return impl( begin, end, stopAtNewline, newlines, lastNewline );
+}
+
+const char* skipWhitespace( const char* begin, const char* end, bool stopAtNewline )
+{
+    static const SkipWhitespaceUncountedFunc impl = selectSkipWhitespaceUncounted();
+    return impl( begin, end, stopAtNewline );
+}
+
+const char* findFirstOf( const char* begin, const char* end, const CharSet& set )
+{
+    static const FindFirstOfFunc impl = selectFindFirstOf();
+
+    // Big sets - plain bitmap lookup.
+    if( set.size() > 4 ){ 
+        for( ; begin < end; begin++ ){
+            if( set.contains( *begin ) )
+                return begin;
+        }
+        return end;
+    }
+
+    char chars[4];
+    size_t count = set.getMembers( chars, 4 );
+    if( count == 0 )
+        return end;
+    if( count == 1 ){
+        const char* p = (const char*)std::memchr( begin, chars[0], end - begin );
+        return ( p ? p : end );
+    }
+    return impl( begin, end, chars, count );
+}
+
+size_t countNewlines( const char* begin, const char* end, const char*& lastNewline )
+{
+    static const CountNewlinesFunc impl = selectCountNewlines();
+    return impl( begin, end, lastNewline );
+}
+
+const char* findNonAscii( const char* begin, const char* end )
+{
+    static const FindNonAsciiFunc impl = selectFindNonAscii();
+    return impl( begin, end );
+}
+
+size_t decodeUtf8( const char* begin, const char* end, char32_t& codepoint )
+{
+    if( begin >= end )
+        return 0;
+
+    unsigned char lead = (unsigned char)*begin;
+    if( lead < 0x80 ){
+        codepoint = lead;
+        return 1;
+    }
+
+    size_t len;
+    char32_t cp, minCp;
+    if( lead >= 0xC2 && lead <= 0xDF ){
+        len = 2; cp = lead & 0x1F; minCp = 0x80;
+    }
+    else if( lead >= 0xE0 && lead <= 0xEF ){
+        len = 3; cp = lead & 0x0F; minCp = 0x800;
+    }
+    else if( lead >= 0xF0 && lead <= 0xF4 ){
+        len = 4; cp = lead & 0x07; minCp = 0x10000;
+    }
+    else // Continuation byte, or lead of an overlong or too big codepoint.
+        return 0;
+
+    if( (size_t)(end - begin) < len )
+        return 0;
+
+    for( size_t i = 1; i < len; i++ ){
+        unsigned char c = (unsigned char)begin[i];
+        if( (c & 0xC0) != 0x80 )
+            return 0;
+        cp = (cp << 6) | (c & 0x3F);
+    }
+
+    if( cp < minCp || cp > 0x10FFFF || ( cp >= 0xD800 && cp <= 0xDFFF ) )
+        return 0;
+
+    codepoint = cp;
+    return len;
+}
+
+const char* validateUtf8( const char* begin, const char* end )
+{
+    while( ( begin = findNonAscii( begin, end ) ) < end ){
+        char32_t cp;
+        size_t len = decodeUtf8( begin, end, cp );
+        if( !len )
+            return begin;
+        begin += len;
+    }
+    return end;
+}
+
+size_t countCodepoints( const char* begin, const char* end )
+{
+    static const CountCodepointsFunc impl = selectCountCodepoints();
+    return impl( begin, end );
+}
+
+void indexDelimited( const char* begin, const char* end, char delimiter, char quote,
+                     bool& inQuotes, std::vector< size_t >& structurals, size_t base )
+{
+    static const IndexDelimitedFunc impl = selectIndexDelimited();
+    impl( begin, end, delimiter, quote, inQuotes, structurals, base );
+}
+
+/*! Accumulates the digits at 'p' to 'value', failing if it exceeds 'limit'.
+ *  Overflow is checked only from the 19th digit on.
+ *  @return pointer past the digits, or nullptr on overflow.
+ */ 
+static const char* parseDigits( const char* p, const char* end, uint64_t& value, uint64_t limit )
+{
+    const char* digits = p;
+    uint64_t v = 0;
+    for( ; p < end && isDigit( *p ); p++ ){
+        unsigned d = (unsigned)( *p - '0' );
+        if( p - digits >= 19 && v > ( limit - d ) / 10 )
+            return nullptr;
+        v = v * 10 + d;
+    }
+    if( v > limit )
+        return nullptr;
+
+    value = v;
+    return p;
+}
+
+const char* parseUInt64( const char* begin, const char* end, uint64_t& value )
+{
+    const char* p = begin;
+    if( p < end && *p == '+' )
+        ++p;
+
+    uint64_t v;
+    const char* digitsEnd = parseDigits( p, end, v, UINT64_MAX );
+    if( !digitsEnd || digitsEnd == p )
+        return begin;
+
+    value = v;
+    return digitsEnd;
+}
+
+const char* parseInt64( const char* begin, const char* end, int64_t& value )
+{
+    const char* p = begin;
+    bool negative = false;
+    if( p < end && ( *p == '-' || *p == '+' ) )
+        negative = ( *p++ == '-' );
+
+    uint64_t v;
+    const char* digitsEnd = parseDigits( p, end, v, (uint64_t)INT64_MAX + negative );
+    if( !digitsEnd || digitsEnd == p )
+        return begin;
+
+    value = ( negative ? (int64_t)( 0 - v ) : (int64_t)v );
+    return digitsEnd;
+}
+
+const char* parseDouble( const char* begin, const char* end, double& value )
+{
+    static const double powersOf10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    const char* p = begin;
+    bool negative = false;
+    if( p < end && ( *p == '-' || *p == '+' ) )
+        negative = ( *p++ == '-' );
+
+    // Up to 19 significant digits are kept in the mantissa. 
+    uint64_t mantissa = 0;
+    int64_t exponent = 0;
+    int digits = 0;
+    bool truncated = false;
+
+    const char* intBegin = p;
+    for( ; p < end && isDigit( *p ); p++ ){
+        if( digits < 19 ){
+            mantissa = mantissa * 10 + (unsigned)( *p - '0' );
+            digits += ( mantissa != 0 );
+        }
+        else{
+            ++exponent;
+            truncated |= ( *p != '0' );
+        }
+    }
+    size_t digitCount = p - intBegin;
+
+    if( p < end && *p == '.' ){
+        const char* fracBegin = ++p;
+        for( ; p < end && isDigit( *p ); p++ ){
+            if( digits < 19 ){
+                mantissa = mantissa * 10 + (unsigned)( *p - '0' );
+                digits += ( mantissa != 0 );
+                --exponent;
+            }
+            else
+                truncated |= ( *p != '0' );
+        }
+        digitCount += p - fracBegin;
+    }
+    if( !digitCount )
+        return begin;
+
+    // Exponent is a part of the number only if it has digits.
+    if( p < end && ( *p == 'e' || *p == 'E' ) ){
+        const char* e = p + 1;
+        bool negativeExp = false;
+        if( e < end && ( *e == '-' || *e == '+' ) )
+            negativeExp = ( *e++ == '-' );
+
+        if( e < end && isDigit( *e ) ){
+            int64_t exp = 0;
+            for( ; e < end && isDigit( *e ); e++ ){
+                if( exp < 100000 )
+                    exp = exp * 10 + ( *e - '0' );
+            }
+            exponent += ( negativeExp ? -exp : exp );
+            p = e;
+        }
+    }
+
+    // Clinger's fast path - both operands are exact, so the result is
+    // correctly rounded.
+    if( !truncated && ( mantissa == 0 || 
+        ( mantissa <= ( (uint64_t)1 << 53 ) && exponent >= -22 && exponent <= 22 ) ) )
+    {
+        double v = (double)mantissa;
+        if( mantissa && exponent < 0 )
+            v /= powersOf10[ -exponent ];
+        else if( mantissa )
+            v *= powersOf10[ exponent ];
+
+        value = ( negative ? -v : v );
+        return p;
+    }
+
+    std::istringstream iss( std::string( begin, p ) );
+    iss.imbue( std::locale::classic() );
+    double v;
+    if( !( iss >> v ) )
+        return begin;
+
+    value = v;
+    return p;
+}
+
+}
+
+}
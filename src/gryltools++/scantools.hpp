@@ -0,0 +1,111 @@
+#ifndef SCANTOOLS_HPP_INCLUDED
+#define SCANTOOLS_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "charclass.hpp"
+
+/*! ScanTools: vectorized byte-scanning kernels used by the readers.
+ *  - Kernels use SSE2/AVX2 where available, selected at runtime by the CPU 
+ *    features, and fall back to the scalar loops otherwise.
+ */ 
+
+namespace gtools{
+
+namespace ScanTools{
+
+    // Same set as std::isspace() in the "C" locale.
+    inline bool isSpace( char c ){
+        return c == ' ' || (unsigned char)(c - '\t') <= (unsigned char)('\r' - '\t');
+    }
+
+    /*! Finds the first non-whitespace byte in [begin, end).
+     *  @param stopAtNewline - if set, '\n' is treated as non-whitespace.
+     *  @param newlines    - incremented by the number of skipped '\n's.
+     *  @param lastNewline - set to the last skipped '\n', unchanged if none.
+     *  @return pointer to the found byte, or 'end' if all was whitespace.
+     */ 
+    const char* skipWhitespace( const char* begin, const char* end, bool stopAtNewline,
+                                size_t& newlines, const char*& lastNewline );
+
+    // Same, without counting the newlines.
+    const char* skipWhitespace( const char* begin, const char* end, bool stopAtNewline );
+
+    /*! Finds the first byte in [begin, end) which belongs to the 'set'.
+     *  - Single chars are searched by memchr, sets of up to 4 chars by SIMD
+     *    compares, and bigger ones by the bitmap lookup.
+     *  @return pointer to the found byte, or 'end' if not found.
+     */ 
+    const char* findFirstOf( const char* begin, const char* end, const CharSet& set );
+
+    /*! Counts '\n's in [begin, end).
+     *  @param lastNewline - set to the last '\n' found, unchanged if none.
+     */ 
+    size_t countNewlines( const char* begin, const char* end, const char*& lastNewline );
+
+    /*! Finds the first non-ASCII byte (0x80 or above) in [begin, end).
+     *  @return pointer to the found byte, or 'end' if all is ASCII.
+     */ 
+    const char* findNonAscii( const char* begin, const char* end );
+
+    /*! Validates UTF-8 in [begin, end). ASCII runs are skipped by vectors,
+     *  and only the multibyte sequences are decoded.
+     *  - Overlong forms, surrogates and codepoints above U+10FFFF are invalid.
+     *  @return pointer to the first invalid sequence, or 'end' if all is 
+     *          valid. Sequence cut by 'end' is reported as invalid too.
+     */ 
+    const char* validateUtf8( const char* begin, const char* end );
+
+    /*! Decodes one UTF-8 sequence from [begin, end).
+     *  @return length of the sequence, or 0 if it's invalid or cut by 'end'.
+     */ 
+    size_t decodeUtf8( const char* begin, const char* end, char32_t& codepoint );
+
+    // Counts codepoints of valid UTF-8 in [begin, end) - all non-continuation bytes.
+    size_t countCodepoints( const char* begin, const char* end );
+
+    /*! Indexes the delimited records (CSV) in [begin, end) - delimiters and
+     *  newlines outside of the quotes are appended to 'structurals', as the
+     *  offsets from 'begin' plus 'base'.
+     *  - Bytes are classified to the bitmasks 64 at a time. Quoted bytes are
+     *    the prefix XOR of the quote mask, so escaped quotes ("") need no
+     *    special handling.
+     *  @param inQuotes - whether 'begin' is inside the quotes. Updated to the
+     *                    state at 'end', so the index can go on from there.
+     */ 
+    void indexDelimited( const char* begin, const char* end, char delimiter, char quote,
+                         bool& inQuotes, std::vector< size_t >& structurals, size_t base );
+
+    inline bool isDigit( char c ){
+        return (unsigned char)(c - '0') <= 9;
+    }
+
+    // Bytes a decimal number can consist of.
+    inline bool isNumberChar( char c ){
+        return isDigit( c ) || c == '.' || c == '-' || c == '+' || c == 'e' || c == 'E';
+    }
+
+    /*! Parse the decimal integer at 'begin' - optional sign, then digits.
+     *  - Unsigned one accepts only the '+' sign.
+     *  @return pointer past the number, or 'begin' if there's no number, or
+     *          it doesn't fit the type. Value is then left unchanged.
+     */ 
+    const char* parseUInt64( const char* begin, const char* end, uint64_t& value );
+    const char* parseInt64( const char* begin, const char* end, int64_t& value );
+
+    /*! Parses the decimal floating point number at 'begin' - optional sign,
+     *  digits with an optional '.', then an optional exponent. 
+     *  - Doesn't depend on the locale. Infinities, NaNs and hex are not parsed.
+     *  - Values exactly representable in the calculation (up to 2^53 mantissa 
+     *    and 10^22 exponent) are converted by the fast path. Others fall back 
+     *    to the correctly rounding conversion of the "C" locale.
+     *  @return pointer past the number, or 'begin' if there's no number, or 
+     *          it overflows. Value is then left unchanged.
+     */ 
+    const char* parseDouble( const char* begin, const char* end, double& value );
+}
+
+}
+
+#endif // SCANTOOLS_HPP_INCLUDED
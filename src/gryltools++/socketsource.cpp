@@ -0,0 +1,47 @@
+#include "socketsource.hpp"
+#include <climits>
+
+#if defined _GRYLTOOL_POSIX
+    #include <fcntl.h>
+#endif
+
+namespace gtools{
+
+SocketSource::~SocketSource()
+{
+    if( ownsSocket )
+        gsockCloseSocket( sock );
+}
+
+long SocketSource::read( char* buff, size_t len )
+{
+    if( len > INT_MAX )
+        len = INT_MAX;
+
+    int red = gsockReceive( sock, buff, len, 0 );
+#if defined _GRYLTOOL_POSIX
+    while( red < 0 && errno == EINTR )
+        red = gsockReceive( sock, buff, len, 0 );
+#endif
+
+    if( red < 0 && gsockIsWouldBlock( gsockGetLastError() ) )
+        return READ_WOULD_BLOCK;
+    return red;
+}
+
+bool SocketSource::isPrefetchable() const
+{
+#if defined _GRYLTOOL_POSIX
+    int flags = fcntl( sock, F_GETFL );
+    return flags >= 0 && !( flags & O_NONBLOCK );
+#else
+    return false;
+#endif
+}
+
+bool SocketSource::setNonBlocking( bool nonBlocking )
+{
+    return gsockSetBlocking( sock, (char)!nonBlocking ) == 0;
+}
+
+}
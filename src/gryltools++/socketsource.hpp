@@ -0,0 +1,44 @@
+#ifndef SOCKETSOURCE_HPP_INCLUDED
+#define SOCKETSOURCE_HPP_INCLUDED
+
+#include "bytesource.hpp"
+#include "grylsocks.h"
+
+/*! Connected socket, read by gsockReceive() straight into the reader's
+ *  buffer - StackReader parses the received data in place.
+ *  - In non-blocking mode, read gives READ_WOULD_BLOCK when nothing has
+ *    arrived yet. Reader then fails without reaching the end, and its
+ *    wouldBlock() is set - parsing resumes when more data arrives.
+ *  - Non-blocking socket can't be prefetched - startPrefetch() refuses it.
+ */
+
+namespace gtools{
+
+class SocketSource : public ByteSource{
+private:
+    SOCKET sock;
+    bool ownsSocket;
+
+public:
+    SocketSource( SOCKET sock, bool ownsSocket = false ) : sock( sock ), ownsSocket( ownsSocket ) {}
+    ~SocketSource();
+
+    SocketSource( const SocketSource& ) = delete;
+    SocketSource& operator=( const SocketSource& ) = delete;
+
+    long read( char* buff, size_t len ) override;
+
+    // Only the blocking socket is prefetched - prefetcher would take
+    // READ_WOULD_BLOCK for the end. Mode of the socket is queried, as it may
+    // be set outside - where it can't be (Windows), it's never prefetched.
+    bool isPrefetchable() const override;
+
+    // Switches the socket's blocking mode. False on failure.
+    bool setNonBlocking( bool nonBlocking );
+
+    SOCKET getSocket() const { return sock; }
+};
+
+}
+
+#endif // SOCKETSOURCE_HPP_INCLUDED
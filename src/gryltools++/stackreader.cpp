@@ -1,72 +1,792 @@
 #include <iostream>
+#include <algorithm>
+#include <chrono>
 #include "stackreader.hpp"
+#include "scantools.hpp"
+#include "lexer.hpp"
+#include "systemcheck.h"
+
+#if defined _GRYLTOOL_POSIX
+    #include <fcntl.h>
+    #include <unistd.h>
+#else
+    #include <io.h>
+#endif
+
+// Counters cost a clock read per source read - compiled in only if asked for.
+#ifdef GTOOLS_READER_STATS
+    #define READER_STAT( expr ) ( expr )
+#else
+    #define READER_STAT( expr )
+#endif
 
 namespace gtools{
 
+#ifdef GTOOLS_READER_STATS
+typedef std::chrono::steady_clock StatsClock;
+
+/*! Counts the read of 'red' bytes (of 'asked'), started at 'start'.
+ */ 
+static void countRead( StackReader::Stats& stats, long red, size_t asked, 
+                       StatsClock::time_point start )
+{
+    stats.blockedNanos += (uint64_t)std::chrono::duration_cast< std::chrono::nanoseconds >(
+                              StatsClock::now() - start ).count();
+    if( red > 0 ){
+        stats.bytesRead += (uint64_t)red;
+        if( (size_t)red < asked )
+            stats.shortReads++;
+    }
+}
+#endif
+
 void StackReader::setupStack()
 {
-    stackBuffer = new char[ stackSize ];
+    stackBuffer = ( inlineStack ? inlineStack : new char[ stackSize ] );
 
     // Allocate a block capable of holding this much characters.
     stackEnd = stackBuffer + stackSize;
     stackPtr = stackEnd; // Empty stack.
+    historyStart = stackPtr;
+}
+
+/*! Frees the stack buffer, unless it's the inline storage.
+ */ 
+void StackReader::freeStack( char* buffer )
+{
+    if( buffer != inlineStack )
+        delete[] buffer;
+}
+
+/*! Sets up the source for a file descriptor - the mapping if possible, and
+ *  the plain reading of the descriptor otherwise.
+ */ 
+void StackReader::setupFileSource( int fd, bool ownsFd )
+{
+#if defined _GRYLTOOL_POSIX
+    // Borrowed descriptor is read from it's current offset, whatever it is.
+    std::unique_ptr< MappedFileSource > mapped( new MappedFileSource( fd, !ownsFd ) );
+    if( mapped->isMapped() ){
+        // Mapping stays valid after the descriptor is closed.
+        if( ownsFd )
+            close( fd );
+        ownedSource = std::move( mapped );
+    }
+    else
+        ownedSource.reset( new FdSource( fd, ownsFd ) );
+#else
+    // Stream closes the descriptor it's opened on - a duplicate, if borrowed.
+    int streamFd = ( ownsFd ? fd : _dup( fd ) );
+    FILE* file = ( streamFd >= 0 ? _fdopen( streamFd, "rb" ) : nullptr );
+    if( file )
+        ownedSource.reset( new CFileSource( file, true ) );
+    else{
+        if( streamFd >= 0 )
+            _close( streamFd );
+        ownedSource.reset( new MemorySource( nullptr, 0 ) );
+        readable = false;
+        streamReadable = false;
+    }
+#endif
+    source = ownedSource.get();
 }
 
 StackReader::StackReader( std::istream& is, size_t prioritySize, size_t bufferSize ) 
-    : use_C( false ), iStream( is ), fileReadSize( bufferSize ), 
-      stackSize( prioritySize + bufferSize )
+    : ownedSource( new IStreamSource( is ) ), fileReadSize( bufferSize ), 
+      priorityStackSize( prioritySize ), stackSize( prioritySize + bufferSize )
 {
+    source = ownedSource.get();
     setupStack();
 }
 
 StackReader::StackReader( FILE* inp, size_t prioritySize, size_t bufferSize )
-    : use_C( true ), iStream( std::cin ), cStream( inp ), 
-      fileReadSize( bufferSize ), stackSize( prioritySize + bufferSize )
+    : ownedSource( new CFileSource( inp ) ), fileReadSize( bufferSize ), 
+      priorityStackSize( prioritySize ), stackSize( prioritySize + bufferSize )
 {
+    source = ownedSource.get();
     setupStack();
 }
 
-// Destructor does nothing - even if using C file streams, we haven't 
-// created that stream.
+StackReader::StackReader( const char* filePath, size_t prioritySize, size_t bufferSize )
+    : fileReadSize( bufferSize ), priorityStackSize( prioritySize ), 
+      stackSize( prioritySize + bufferSize )
+{
+    setupStack();
+
+#if defined _GRYLTOOL_POSIX
+    int fd = open( filePath, O_RDONLY );
+    if( fd >= 0 ){
+        setupFileSource( fd, true );
+        return;
+    }
+#else
+    FILE* file = fopen( filePath, "rb" );
+    if( file ){
+        ownedSource.reset( new CFileSource( file, true ) );
+        source = ownedSource.get();
+        return;
+    }
+#endif
+    // File can't be opened - reader is empty.
+    ownedSource.reset( new MemorySource( nullptr, 0 ) );
+    source = ownedSource.get();
+    readable = false;
+    streamReadable = false;
+}
+
+StackReader::StackReader( int fd, size_t prioritySize, size_t bufferSize )
+    : fileReadSize( bufferSize ), priorityStackSize( prioritySize ), 
+      stackSize( prioritySize + bufferSize )
+{
+    setupStack();
+    setupFileSource( fd, false );
+}
+
+StackReader::StackReader( ByteSource& src, size_t prioritySize, size_t bufferSize )
+    : source( &src ), fileReadSize( bufferSize ), priorityStackSize( prioritySize ), 
+      stackSize( prioritySize + bufferSize )
+{
+    setupStack();
+}
+
+StackReader::StackReader( std::unique_ptr< ByteSource > src, size_t prioritySize, size_t bufferSize )
+    : ownedSource( std::move( src ) ), fileReadSize( bufferSize ), 
+      priorityStackSize( prioritySize ), stackSize( prioritySize + bufferSize )
+{
+    source = ownedSource.get();
+    setupStack();
+}
+
+StackReader::StackReader( ByteSource& src, char* storage, size_t prioritySize, size_t bufferSize )
+    : source( &src ), inlineStack( storage ), fileReadSize( bufferSize ), 
+      priorityStackSize( prioritySize ), stackSize( prioritySize + bufferSize )
+{
+    setupStack();
+}
+
+StackReader::StackReader( std::function< long(char*, size_t) > readCallback, 
+                          size_t prioritySize, size_t bufferSize )
+    : ownedSource( new CallbackSource( readCallback ) ), fileReadSize( bufferSize ), 
+      priorityStackSize( prioritySize ), stackSize( prioritySize + bufferSize )
+{
+    source = ownedSource.get();
+    setupStack();
+}
+
+// Destructor only releases what the reader has created itself - the stack,
+// and the source. Passed streams and sources are not closed.
 StackReader::~StackReader()
 {
+    // Wake the prefetcher if it's waiting for a free chunk, and wait for it.
+    if( prefetchThread.joinable() ){
+        prefetchQueues->freeChunks.push( PrefetchChunk{ nullptr, 0 } );
+        prefetchThread.join();
+    }
+
     if(stackBuffer)
-        delete[] stackBuffer;
+        freeStack( stackBuffer );
+    for( auto& seg : segments )
+        freeStack( seg.buffer );
+    delete[] spareStack;
 }
 
-/*! If called, it will fetch n='fileReadSize' characters from a stream.
- * - The data gets put to stack, overwriting any existing data. 
- * - If some active data is still on stack, it assumes the data is before the
- *   file fetch sector (before the stackSize-fileReadSize point).
- * @return true if successful.
+/*! Prefetching thread's loop. Fills free chunks, until stream ends or 
+ *  a null chunk is received (stop signal).
  */ 
-bool StackReader::fetchBuffer()
+void StackReader::prefetchLoop()
 {
-    int red = 0;
-    char* readSection = (stackBuffer + stackSize) - fileReadSize;
+    while(1){
+        PrefetchChunk chunk = prefetchQueues->freeChunks.pop();
+        if( !chunk.data )
+            break;
+
+        chunk.size = source->read( chunk.data, fileReadSize );
+        prefetchQueues->filledChunks.push( chunk );
+
+        if( chunk.size <= 0 ) // End of stream - no more reads.
+            break;
+    }
+}
+
+/*! Takes the next chunk filled by the prefetcher, waiting for it.
+ */ 
+StackReader::PrefetchChunk StackReader::takeFilledChunk()
+{
+#ifdef GTOOLS_READER_STATS
+    StatsClock::time_point start = StatsClock::now();
+    PrefetchChunk chunk = prefetchQueues->filledChunks.pop();
+    countRead( stats, chunk.size, fileReadSize, start );
+    return chunk;
+#else
+    return prefetchQueues->filledChunks.pop();
+#endif
+}
+
+/*! Reads from the source - counted in the stats, if enabled.
+ */ 
+long StackReader::sourceRead( char* buff, size_t len )
+{
+#ifdef GTOOLS_READER_STATS
+    StatsClock::time_point start = StatsClock::now();
+    long red = source->read( buff, len );
+    countRead( stats, red, len, start );
+    return red;
+#else
+    return source->read( buff, len );
+#endif
+}
+
+bool StackReader::sourceRegion( const char*& region, size_t& regionLen )
+{
+#ifdef GTOOLS_READER_STATS
+    StatsClock::time_point start = StatsClock::now();
+    bool got = source->getRegion( region, regionLen );
+    countRead( stats, ( got ? (long)regionLen : 0 ), regionLen, start );
+    return got;
+#else
+    return source->getRegion( region, regionLen );
+#endif
+}
+
+/*! Starts prefetching the stream on a background thread.
+ *  @param chunkCount - count of chunks, including the one being parsed.
+ *  @return true if started, false if not needed (mapped file, ended stream),
+ *          not allowed by the source, or already running.
+ */ 
+bool StackReader::startPrefetch( size_t chunkCount )
+{
+    if( prefetching || source->isDirect() || !source->isPrefetchable() || !streamReadable )
+        return false;
+    if( chunkCount < 2 )
+        chunkCount = 2;
+
+    prefetchQueues.reset( new PrefetchQueues() );
+    prefetchMemory.reset( new char[ chunkCount * fileReadSize ] );
+    for( size_t i = 0; i < chunkCount; i++ )
+        prefetchQueues->freeChunks.push( PrefetchChunk{ prefetchMemory.get() + i * fileReadSize, 0 } );
+
+    prefetchChunks = chunkCount;
+    prefetching = true;
+    prefetchThread = std::thread( &StackReader::prefetchLoop, this );
+    return true;
+}
+
+bool StackReader::isPrefetching() const {
+    return prefetching;
+}
+
+size_t StackReader::getPrefetchChunkCount() const {
+    return prefetchChunks + extraChunks.size();
+}
+
+bool StackReader::wouldBlock() const {
+    return blocked;
+}
+
+bool StackReader::statsEnabled(){
+#ifdef GTOOLS_READER_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*! Count of the unread bytes the reader holds - in the window, the stack
+ *  segments, and the suspended window.
+ */ 
+size_t StackReader::bufferedLength() const
+{
+    size_t len = (size_t)(stackEnd - stackPtr);
+    for( const auto& seg : segments )
+        len += (size_t)(seg.end - seg.ptr);
+    if( suspendedPtr )
+        len += (size_t)(suspendedEnd - suspendedPtr);
+    return len;
+}
+
+/*! Gets the counters. Consumed bytes are the ones which got to the buffer,
+ *  less the ones still unread - so unread and rewound bytes aren't counted
+ *  until they're read again.
+ */ 
+StackReader::Stats StackReader::getStats() const
+{
+    Stats current = stats;
+#ifdef GTOOLS_READER_STATS
+    uint64_t received = stats.bytesRead + injectedBytes;
+    uint64_t buffered = bufferedLength();
+    current.bytesConsumed = ( received > buffered ? received - buffered : 0 );
+#endif
+    return current;
+}
+
+/*! Zeroes the counters. Bytes buffered now are counted as consumed once read.
+ */ 
+void StackReader::resetStats()
+{
+    stats = Stats();
+    injectedBytes = bufferedLength();
+}
+
+/*! Gives the current chunk back to the prefetcher. If views point to it, 
+ *  the chunk is held until they're released, and prefetcher gets a spare
+ *  one instead - new one is allocated only if there's no spare.
+ */ 
+void StackReader::releaseCurrentChunk()
+{
+    if( !currentChunk.data )
+        return;
+
+    if( pinnedChunk ){
+        heldChunks.push_back( currentChunk );
+        if( spareChunks.empty() ){
+            extraChunks.emplace_back( new char[ fileReadSize ] );
+            spareChunks.push_back( extraChunks.back().get() );
+        }
+        prefetchQueues->freeChunks.push( PrefetchChunk{ spareChunks.back(), 0 } );
+        spareChunks.pop_back();
+        pinnedChunk = false;
+    }
+    else
+        prefetchQueues->freeChunks.push( currentChunk );
+
+    currentChunk = PrefetchChunk{ nullptr, 0 };
+}
+
+/*! Swaps the next prefetched chunk in as the read window, and gives the 
+ *  current one back to the prefetcher.
+ *  @return false if stream has ended.
+ */ 
+bool StackReader::fetchPrefetched()
+{
+    releaseCurrentChunk();
+    windowBase = nullptr;
+
+    PrefetchChunk chunk = takeFilledChunk();
+    if( chunk.size <= 0 ){
+        // Leave the released chunk - switch to the empty stack.
+        stackEnd = stackBuffer + stackSize;
+        stackPtr = stackEnd;
+        historyStart = stackPtr;
+        return false;
+    }
+
+    currentChunk = chunk;
+    windowBase = chunk.data;
+    stackPtr = chunk.data;
+    stackEnd = chunk.data + chunk.size;
+    historyStart = stackPtr;
+    return true;
+}
+
+/*! Copies up to 'len' next bytes to 'buff' - from the stack segments, 
+ *  suspended window, 
+ *  next prefetched chunk or direct region, or the source itself.
+ *  - Used when data must be contiguous with the kept bytes, so borrowed
+ *    windows can't be used as they are. What's left of a direct region 
+ *    stays as a suspended window.
+ *  @return count of bytes copied, 0 or less if nothing left.
+ */ 
+long StackReader::readNext( char* buff, size_t len )
+{
+    while( !segments.empty() ){
+        StackSegment& seg = segments.back();
+        size_t cnt = (size_t)(seg.end - seg.ptr);
+        cnt = ( cnt > len ? len : cnt );
+
+        std::memcpy( buff, seg.ptr, cnt );
+        seg.ptr += cnt;
+        READER_STAT( stats.movedBytes += cnt );
+
+        if( seg.ptr >= seg.end ){ // Segment drained.
+            releaseSegment( seg.buffer, seg.size, seg.pinned );
+            segments.pop_back();
+        }
+        if( cnt )
+            return (long)cnt;
+    }
+
+    if( suspendedPtr ){
+        size_t cnt = (size_t)(suspendedEnd - suspendedPtr);
+        cnt = ( cnt > len ? len : cnt );
+
+        std::memcpy( buff, suspendedPtr, cnt );
+        suspendedPtr += cnt;
+        READER_STAT( stats.movedBytes += cnt );
+
+        if( suspendedPtr >= suspendedEnd ){ // Borrowed window drained.
+            suspendedPtr = nullptr;
+            suspendedEnd = nullptr;
+            windowBase = nullptr;
+            releaseCurrentChunk();
+        }
+        if( cnt )
+            return (long)cnt;
+    }
+
+    if( prefetching ){
+        if( !streamReadable )
+            return 0;
+
+        PrefetchChunk chunk = takeFilledChunk();
+        long cnt = chunk.size;
+        if( cnt > 0 ){
+            std::memcpy( buff, chunk.data, cnt );
+            READER_STAT( stats.movedBytes += (uint64_t)cnt );
+        }
+        prefetchQueues->freeChunks.push( chunk );
+        return cnt;
+    }
+
+    if( source->isDirect() ){
+        const char* region;
+        size_t regionLen;
+        if( !streamReadable || !sourceRegion( region, regionLen ) || !regionLen )
+            return 0;
+
+        windowBase = (char*)region;
+        suspendedPtr = windowBase;
+        suspendedEnd = windowBase + regionLen;
+        return readNext( buff, len );
+    }
+
+    long red = sourceRead( buff, len );
+    blocked = ( red == ByteSource::READ_WOULD_BLOCK );
+    return red;
+}
+
+/*! Moves the kept bytes [keepFrom, stackEnd) to the stack buffer, so that
+ *  at least 'fileReadSize' free bytes follow them.
+ *  - If bytes are already in the stack, and enough space is after them, 
+ *    nothing is moved. Otherwise they're moved after the priority area, 
+ *    and the stack grows if needed.
+ *  - If views point to the stack, it's replaced instead of overwriting.
+ */ 
+void StackReader::placeKept( char* keepFrom, size_t keepLen )
+{
+    bool keptInStack = !isWindowBorrowed();
+    if( keptInStack && !pinnedStack && 
+        (size_t)((stackBuffer + stackSize) - stackEnd) >= fileReadSize )
+        return;
+
+    size_t neededSize = priorityStackSize + keepLen + fileReadSize;
+    char* dest;
+
+    if( neededSize > stackSize || pinnedStack ){
+        size_t newStackSize = ( neededSize > stackSize ? 
+                                std::max( neededSize, 2 * stackSize ) : stackSize );
+        char* newBuffer = new char[ newStackSize ];
+        READER_STAT( stats.reallocations++ );
 
-    if(use_C){
-        red = fread( readSection, 1, fileReadSize, cStream );
+        dest = newBuffer + priorityStackSize;
+        std::memcpy( dest, keepFrom, keepLen );
+
+        retireStack();
+        stackBuffer = newBuffer;
+        stackSize = newStackSize;
     }
     else{
-        iStream.read( readSection, fileReadSize );  
-        red = iStream.gcount();
+        dest = stackBuffer + priorityStackSize;
+        std::memmove( dest, keepFrom, keepLen );
+    }
+    READER_STAT( stats.movedBytes += keepLen );
+
+    stackPtr = dest + (stackPtr - keepFrom);
+    stackEnd = dest + keepLen;
+    historyStart = ( historyStart > keepFrom ? dest + (historyStart - keepFrom) : dest );
+    for( auto& mark : marks ){
+        if( mark )
+            mark = dest + (mark - keepFrom);
     }
 
+    // If kept bytes were in a borrowed window, we've left it now.
+    if( !keptInStack ){
+        windowBase = nullptr;
+        releaseCurrentChunk();
+    }
+}
+
+/*! Gets the point from which the window's bytes must be kept on refill -
+ *  'keepFrom', or earlier, if history or marked bytes must be retained.
+ */ 
+char* StackReader::retentionPoint( char* keepFrom ) const
+{
+    if( historySize ){
+        char* histFrom = ( (size_t)(stackPtr - historyStart) > historySize ? 
+                           stackPtr - historySize : historyStart );
+        if( histFrom < keepFrom )
+            keepFrom = histFrom;
+    }
+    for( char* mark : marks ){
+        if( mark && mark < keepFrom )
+            keepFrom = mark;
+    }
+    return keepFrom;
+}
+
+/*! Switches to the next read window, when nothing must be kept.
+ * - Stack segments put aside by the putbacks are resumed first.
+ * - If a borrowed window was suspended by the putback overlay, it gets 
+ *   resumed, and nothing is copied.
+ * - If prefetching, the next prefetched chunk becomes the read window.
+ * - Direct sources' regions become the read window.
+ * - Otherwise n='fileReadSize' characters get read to the read section, in
+ *   the back of the stack, overwriting any existing data there.
+ * @return true if new data was acquired.
+ */ 
+bool StackReader::nextWindow()
+{
+    while( !segments.empty() ){
+        popSegment();
+        if( stackPtr < stackEnd )
+            return true;
+    }
+
+    if( suspendedPtr ){
+        stackPtr = suspendedPtr;
+        stackEnd = suspendedEnd;
+        suspendedPtr = nullptr;
+        suspendedEnd = nullptr;
+
+        if( stackPtr < stackEnd )
+            return true;
+    }
+
+    if( prefetching )
+        return streamReadable && fetchPrefetched();
+
+    if( source->isDirect() ){
+        const char* region;
+        size_t regionLen;
+        if( !streamReadable || !sourceRegion( region, regionLen ) || !regionLen )
+            return false;
+
+        windowBase = (char*)region;
+        stackPtr = windowBase;
+        stackEnd = windowBase + regionLen;
+        return true;
+    }
+
+    unpinStack();
+    char* readSection = (stackBuffer + stackSize) - fileReadSize;
+    long red = sourceRead( readSection, fileReadSize );
     if( red <= 0 ){
-        if( stackEnd - stackPtr <= 0 ) // No data
-            readable = false;
-        streamReadable = false;
+        blocked = ( red == ByteSource::READ_WOULD_BLOCK );
+        return false;
+    }
+
+    // Set a stack end to how much we've read. 
+    stackPtr = readSection;
+    stackEnd = readSection + red;
+    return true;
+}
+
+/*! Gets new data after stackEnd, keeping [keepFrom, stackEnd) contiguous
+ *  with it. If nothing is kept, borrowed windows are used without copying.
+ * - Retained history, and bytes after the active marks are always kept.
+ * @return true if new data was acquired.
+ */ 
+bool StackReader::refill( char* keepFrom )
+{
+    blocked = false;
+    READER_STAT( stats.refills++ );
+    if( !trackingPosition )
+        return refillStack( keepFrom );
+
+    // Consumed bytes may be dropped - count them first.
+    syncPosition();
+    bool refilled = refillStack( keepFrom );
+    positionSyncPtr = stackPtr;
+    return refilled;
+}
+
+/*! Refills the stack, keeping the bytes from 'keepFrom' (and the ones 
+ *  retained for marks and history).
+ *  @return false if there's no more data.
+ */ 
+bool StackReader::refillStack( char* keepFrom )
+{
+    keepFrom = retentionPoint( keepFrom );
+    size_t keepLen = (size_t)(stackEnd - keepFrom);
+
+    if( keepLen ){
+        placeKept( keepFrom, keepLen );
+        long red = readNext( stackEnd, (stackBuffer + stackSize) - stackEnd );
+
+        if( red > 0 ){
+            stackEnd += red;
+            return true;
+        }
+    }
+    else{
+        bool fetched = nextWindow();
+
+        // Marks at the end of the old window now point to the new one.
+        historyStart = stackPtr;
+        for( auto& mark : marks ){
+            if( mark )
+                mark = stackPtr;
+        }
+        if( fetched )
+            return true;
+    }
+
+    // Non-blocking source has nothing yet - it's not the end.
+    if( blocked )
         return false;
+
+    if( stackEnd - stackPtr <= 0 ) // No data
+        readable = false;
+    streamReadable = false;
+    return false;
+}
+
+/*! If called, it will fetch new data to the empty stack.
+ * @return true if successful.
+ */ 
+bool StackReader::fetchBuffer()
+{
+    return refill( stackEnd );
+}
+
+/*! Fetches more data, keeping the unread bytes contiguous with it.
+ * @return true if successful.
+ */ 
+bool StackReader::fetchMore()
+{
+    return refill( stackPtr );
+}
+
+/*! Frees the stack buffer, or if views point to it, moves it to the 
+ *  retired ones. Retired buffers get freed when all views are released.
+ */ 
+void StackReader::retireBuffer( char* buffer, bool pinned )
+{
+    if( pinned && buffer != inlineStack )
+        retiredBuffers.emplace_back( buffer );
+    else
+        freeStack( buffer );
+}
+
+void StackReader::retireStack()
+{
+    retireBuffer( stackBuffer, pinnedStack );
+    pinnedStack = false;
+    stackBuffer = nullptr;
+}
+
+/*! Puts the current stack aside as a segment, and switches to a new, empty
+ *  one with at least 'frontSpace' free bytes. 
+ *  - Used when bytes are put back in front of the data which doesn't leave
+ *    them enough space, so that the data never has to be moved - putbacks
+ *    cost just the bytes put back.
+ */ 
+void StackReader::pushSegment( size_t frontSpace )
+{
+    // New stack is at least twice the data put aside, so that consecutive
+    // putbacks need only a few segments, without taking more than the data.
+    size_t newStackSize = std::max( stackSize, frontSpace + priorityStackSize );
+    newStackSize = std::max( newStackSize, 2 * (size_t)(stackEnd - stackPtr) );
+
+    segments.push_back( StackSegment{ stackBuffer, stackSize, stackPtr, stackEnd, pinnedStack } );
+    pinnedStack = false;
+
+    if( spareStack && spareSize >= newStackSize ){
+        stackBuffer = spareStack;
+        stackSize = spareSize;
+        spareStack = nullptr;
+        spareSize = 0;
     }
     else{
-        if( stackPtr > readSection )
-            stackPtr = readSection;
+        stackSize = newStackSize;
+        stackBuffer = new char[ stackSize ];
+        READER_STAT( stats.reallocations++ );
+    }
+    stackEnd = stackBuffer + stackSize;
+    stackPtr = stackEnd;
+    historyStart = stackPtr;
+}
 
-        // Set a stack end to how much we've read. 
-        stackEnd = readSection + red;
+/*! Releases the drained stack segment's buffer. Largest unpinned one is 
+ *  kept as a spare, to be reused by the next putbacks.
+ */ 
+void StackReader::releaseSegment( char* buffer, size_t size, bool pinned )
+{
+    if( pinned || buffer == inlineStack || size <= spareSize ){
+        retireBuffer( buffer, pinned );
+        return;
     }
-    return true;
+    delete[] spareStack;
+    spareStack = buffer;
+    spareSize = size;
+}
+
+/*! Drops the exhausted stack, and resumes the last segment put aside.
+ */ 
+void StackReader::popSegment()
+{
+    StackSegment seg = segments.back();
+    segments.pop_back();
+
+    releaseSegment( stackBuffer, stackSize, pinnedStack );
+    pinnedStack = false;
+    stackBuffer = seg.buffer;
+    stackSize = seg.size;
+    stackPtr = seg.ptr;
+    stackEnd = seg.end;
+    pinnedStack = seg.pinned;
+}
+
+/*! Replaces the stack pinned by the views with a new one, carrying the live
+ *  data over, so that the stack could be written to.
+ */ 
+void StackReader::unpinStack()
+{
+    if( !pinnedStack )
+        return;
+
+    char* newBuffer = new char[ stackSize ];
+    READER_STAT( stats.reallocations++ );
+    if( !isWindowBorrowed() ){
+        size_t offset = historyStart - stackBuffer;
+        size_t len = stackEnd - historyStart;
+        std::memcpy( newBuffer + offset, historyStart, len );
+        READER_STAT( stats.movedBytes += len );
+
+        stackPtr = newBuffer + (stackPtr - stackBuffer);
+        stackEnd = newBuffer + offset + len;
+        historyStart = newBuffer + offset;
+        for( auto& mark : marks ){
+            if( mark )
+                mark = newBuffer + (mark - stackBuffer);
+        }
+    }
+
+    retireStack();
+    stackBuffer = newBuffer;
+}
+
+/*! Checks if the read window currently points to the borrowed memory - the
+ *  direct source's region, or prefetched chunk.
+ *  - The only other window is the stack buffer, which is used as an overlay 
+ *    while the borrowed window is suspended.
+ */ 
+bool StackReader::isWindowBorrowed() const
+{
+    return windowBase && !suspendedPtr;
+}
+
+/*! Suspends the borrowed window, and switches to the empty stack buffer, so
+ *  that bytes could be put back on it. Window is resumed by fetchBuffer(),
+ *  once the overlay gets exhausted.
+ */ 
+void StackReader::suspendWindow()
+{
+    suspendedPtr = stackPtr;
+    suspendedEnd = stackEnd;
+
+    stackEnd = stackBuffer + stackSize;
+    stackPtr = stackEnd;
+    historyStart = stackPtr;
 }
 
 /*! Function ensures that stack has at least some space in front and back.
@@ -78,6 +798,8 @@ bool StackReader::fetchBuffer()
  */ 
 bool StackReader::ensureSpace( size_t frontSpace, size_t backSpace, bool moveAllowed )
 {
+    unpinStack();
+
     size_t newStackSize = 0, newDataStart = 0; // New stack properties.
     size_t dataSz = stackEnd - stackPtr;
         
@@ -125,11 +847,13 @@ bool StackReader::ensureSpace( size_t frontSpace, size_t backSpace, bool moveAll
 
         if( !moveDestination )
             return false;
+        READER_STAT( stats.reallocations++ );
     }
 
     // Check if memmoves needed.
     if( newDataStart ){
         std::memmove( moveDestination + newDataStart, stackPtr, dataSz );
+        READER_STAT( stats.movedBytes += dataSz );
         // Set new stack pointers.
         stackPtr = moveDestination + newDataStart;
         stackEnd = stackPtr + dataSz;
@@ -142,25 +866,20 @@ bool StackReader::ensureSpace( size_t frontSpace, size_t backSpace, bool moveAll
 
     // If we have reallocated stuff, we need to delete old buffer, and set the new pointer.
     if( newStackSize ){
-        delete[] stackBuffer;
+        freeStack( stackBuffer );
         stackBuffer = moveDestination;
     }
 
     return true;
 }
 
-inline bool StackReader::checkSetReadable(){
-    //if( !readable )
-    //    return false;
-    if( stackPtr >= stackEnd ){
-        if( !fetchBuffer() )
-            return false;
-    }
-    return true;
-}
-
-bool StackReader::isReadable() {
-    return (readable ? checkSetReadable() : false);
+/*! Slow path of the inline readers - refills the exhausted buffer.
+ *  @return false if there's no more data.
+ */ 
+bool StackReader::refillSlow(){
+    if( stackPtr < stackEnd )
+        return true;
+    return fetchBuffer();
 }
 
 size_t StackReader::getFrontSize() const {
@@ -171,10 +890,85 @@ size_t StackReader::getBackSize() const {
     return fileReadSize;
 }
 
+/*! Sets the size of the history - count of the last consumed bytes which
+ *  are retained on refills, so that they could be unread. 
+ *  - Retaining history makes refills copy, instead of borrowing the windows.
+ */ 
+void StackReader::setHistorySize( size_t size ){
+    historySize = size;
+}
+
+size_t StackReader::getHistorySize() const {
+    return historySize;
+}
+
+void StackReader::setPositionTracking( bool enabled ){
+    trackingPosition = enabled;
+    positionSyncPtr = stackPtr;
+    syncedPosition = Position();
+}
+
+bool StackReader::isTrackingPosition() const {
+    return trackingPosition;
+}
+
+/*! @return position of the next byte, or line 0 column 0 if not tracking.
+ */ 
+StackReader::Position StackReader::position(){
+    if( trackingPosition )
+        syncPosition();
+    return syncedPosition;
+}
+
+/*! Counts the bytes consumed since the last sync into the position.
+ */ 
+void StackReader::syncPosition()
+{
+    if( stackPtr <= positionSyncPtr )
+        return;
+
+    const char* lastNewline = nullptr;
+    size_t newlines = ScanTools::countNewlines( positionSyncPtr, stackPtr, lastNewline );
+    if( newlines ){
+        syncedPosition.line += newlines;
+        syncedPosition.column = (size_t)( stackPtr - lastNewline ) - 1;
+    }
+    else
+        syncedPosition.column += (size_t)( stackPtr - positionSyncPtr );
+    positionSyncPtr = stackPtr;
+}
+
+/*! Moves the synced position back over 'sz' bytes at the stack pointer,
+ *  which were unread or put back.
+ *  - If they contain a newline, column is counted from the last newline 
+ *    before them which is still retained (in the history), or from the 
+ *    start of the retained bytes.
+ */ 
+void StackReader::unconsumePosition( size_t sz )
+{
+    const char* lastNewline = nullptr;
+    size_t newlines = ScanTools::countNewlines( stackPtr, stackPtr + sz, lastNewline );
+    if( newlines ){
+        syncedPosition.line -= std::min( syncedPosition.line, newlines );
+
+        const char* lineStart = stackPtr;
+        while( lineStart > historyStart && lineStart[ -1 ] != '\n' )
+            --lineStart;
+        syncedPosition.column = (size_t)( stackPtr - lineStart );
+    }
+    else
+        syncedPosition.column -= std::min( syncedPosition.column, sz );
+    positionSyncPtr = stackPtr;
+}
+
 size_t StackReader::currentLength() const {
     return (size_t)(stackEnd - stackPtr);
 }
 
+bool StackReader::isDirect() const {
+    return source->isDirect();
+}
+
 bool StackReader::getChar( char& chr, int skipmode, size_t& endlines, size_t& posInLine )
 {
     if(skipmode != SKIPMODE_NOSKIP){
@@ -191,30 +985,19 @@ bool StackReader::getChar( char& chr, int skipmode, size_t& endlines, size_t& po
     return true;
 }
 
-bool StackReader::getChar( char& chr, int skipmode ){
-    size_t a,b;
-    return getChar(chr, skipmode, a, b);
-}
-
-bool StackReader::getChar( char& chr ){
-    if( !checkSetReadable() )
+bool StackReader::getChar( char& chr, int skipmode )
+{
+    if(skipmode != SKIPMODE_NOSKIP){
+        if( !skipWhitespace( skipmode ) )
+           return false; 
+    }
+    else if( !checkSetReadable() )
         return false;
+
     chr = *( stackPtr++ );
     return true;
 }
 
-int StackReader::getChar(){
-    if( !checkSetReadable() )
-        return -1;
-    return *( stackPtr++ );
-}
-
-int StackReader::peekChar(){
-    if( !checkSetReadable() )
-        return -1;
-    return *( stackPtr ); 
-}
-
 size_t StackReader::getString( char* st, size_t sz, int skipmode, size_t& endl, size_t& posl )
 {
     if(skipmode != SKIPMODE_NOSKIP){
@@ -225,7 +1008,25 @@ size_t StackReader::getString( char* st, size_t sz, int skipmode, size_t& endl,
     else if( !checkSetReadable() )
         return 0;
 
-    // Now get that string in a Loop!
+    return copyString( st, sz );
+}
+
+size_t StackReader::getString( char* st, size_t sz, int skipmode )
+{
+    if(skipmode != SKIPMODE_NOSKIP){
+        if( !skipWhitespace( skipmode ) )
+           return 0; 
+    }
+    else if( !checkSetReadable() )
+        return 0;
+
+    return copyString( st, sz );
+}
+
+/*! Copies up to 'sz' bytes from the current position, refilling as needed.
+ */ 
+size_t StackReader::copyString( char* st, size_t sz )
+{
     size_t read = 0, readTotal = 0;
     while(readTotal < sz && readable){
         read = (size_t)(stackEnd - stackPtr);
@@ -244,55 +1045,90 @@ size_t StackReader::getString( char* st, size_t sz, int skipmode, size_t& endl,
     return readTotal;
 }
 
-size_t StackReader::getString( char* st, size_t sz, int skipmode ){
-    size_t a,b;
-    return getString( st, sz, skipmode, a, b );
-}
-
 size_t StackReader::getString( std::string& str, int skipmode ){
     return getString( &(str[0]), str.size(), skipmode );
 }
 
+/*! Parses the number at the current position by 'parse' (of ScanTools).
+ *  - Number is parsed straight from the buffer. If it's cut by the window's
+ *    end, more is fetched, keeping it contiguous.
+ */ 
+template< typename T >
+bool StackReader::getNumber( T& value, int skipmode, 
+                             const char* (*parse)( const char*, const char*, T& ) )
+{
+    if( skipmode != SKIPMODE_NOSKIP ){
+        if( !skipWhitespace( skipmode ) )
+            return false;
+    }
+    else if( !readable || !checkSetReadable() )
+        return false;
+
+    size_t len = 0;
+    while(1){
+        const char* p = stackPtr + len;
+        while( p < stackEnd && ScanTools::isNumberChar( *p ) )
+            ++p;
+
+        len = p - stackPtr;
+        if( p < stackEnd || !fetchMore() )
+            break;
+    }
+
+    const char* numberEnd = parse( stackPtr, stackPtr + len, value );
+    if( numberEnd == stackPtr )
+        return false;
+
+    stackPtr = (char*)numberEnd;
+    return true;
+}
+
+bool StackReader::getInt64( int64_t& value, int skipmode ){
+    return getNumber( value, skipmode, ScanTools::parseInt64 );
+}
+
+bool StackReader::getUInt64( uint64_t& value, int skipmode ){
+    return getNumber( value, skipmode, ScanTools::parseUInt64 );
+}
+
+bool StackReader::getDouble( double& value, int skipmode ){
+    return getNumber( value, skipmode, ScanTools::parseDouble );
+}
+
+/*! Skips the whitespace without counting the newlines.
+ */ 
 bool StackReader::skipWhitespace( int skipmode )
 {
-    size_t a,b;
-    return skipWhitespace(skipmode, a, b);
+    if(!readable)
+        return false;
+
+    bool stopAtNewline = ( skipmode == SKIPMODE_SKIPWS_NONEWLINE );
+    while(1){
+        stackPtr = (char*)ScanTools::skipWhitespace( stackPtr, stackEnd, stopAtNewline );
+        if( stackPtr < stackEnd )
+            return true;
+        if( !fetchBuffer() )
+            return false;
+    }
 }
 
 bool StackReader::skipWhitespace( int skipmode, size_t& endlines, size_t& posInLine ){
     if(!readable)
         return false;
     
-    char* lastEndlPos = stackPtr;
+    const char* lastEndlPos = stackPtr;
     size_t originalEndlines = endlines;
+    bool stopAtNewline = ( skipmode == SKIPMODE_SKIPWS_NONEWLINE );
     while(1){
-        while(stackPtr < stackEnd){
-            char c = *stackPtr; // Get a character at current stack pointer position.
-
-            if(c == '\n'){
-                if(skipmode == SKIPMODE_SKIPWS_NONEWLINE){
-                    // Leave pointing to the '\n'.
-                    posInLine = ( endlines==originalEndlines ? 
-                                  posInLine + (size_t)(stackPtr - lastEndlPos) :
-                                  (size_t)(stackPtr - lastEndlPos) ); 
-                    return true; // Because newlines are not skipped.
-                }
-
-                // We're skipping it. Increment line counters.
-                ++endlines;
-                lastEndlPos = stackPtr;
-
-                ++stackPtr;
-                continue;
-            }
-            else if( !std::isspace( c ) ){ // Non-whitespace character found.
-                posInLine = ( endlines==originalEndlines ? 
-                              posInLine + (size_t)(stackPtr - lastEndlPos) :
-                              (size_t)(stackPtr - lastEndlPos) );
-                return true;
-            }
-
-            ++stackPtr;
+        // Skip whole window at once. Newlines are counted by the kernel.
+        stackPtr = (char*)ScanTools::skipWhitespace( stackPtr, stackEnd, stopAtNewline, 
+                                                     endlines, lastEndlPos );
+
+        if( stackPtr < stackEnd ){ // Non-whitespace character found (or '\n' if not skipping it)
+            posInLine = ( endlines==originalEndlines ? 
+                          posInLine + (size_t)(stackPtr - lastEndlPos) :
+                          (size_t)(stackPtr - lastEndlPos) );
+            return true;
         }
 
         // Calculate current position after endline, to setup new, adapted for new stackPtr.
@@ -313,57 +1149,65 @@ bool StackReader::skipWhitespace( int skipmode, size_t& endlines, size_t& posInL
 }
 
 bool StackReader::skipUntilChar( char chr ){ 
-    size_t a,b;
-    return skipUntilChar( chr, a, b );
+    return skipUntilSet( CharSet( chr ) );
 }
 
 bool StackReader::skipUntilDelim( const std::string& delims ){
-    size_t a,b;
-    return skipUntilDelim( delims, a, b );
+    return skipUntilSet( CharSet( delims ) );
 }
 
-bool StackReader::skipUntilChar( char chr, size_t& endls, size_t& posls )
+/*! Skips until the first of 'delims', without counting the newlines.
+ */ 
+bool StackReader::skipUntilSet( const CharSet& delims )
 {
-    return skipUntil( [chr](char c){ 
-        if( c == chr ) // char found
+    if(!readable)
+        return false;
+
+    while(1){
+        stackPtr = (char*)ScanTools::findFirstOf( stackPtr, stackEnd, delims );
+        if( stackPtr < stackEnd )
             return true;
-        return false;        
-    }, endls, posls );   
+        if( !fetchBuffer() )
+            return false;
+    }
+}
+
+bool StackReader::skipUntilChar( char chr, size_t& endls, size_t& posls )
+{
+    return skipUntil( CharSet( chr ), endls, posls );   
 }
 
 bool StackReader::skipUntilDelim( const std::string& delims, size_t& endls, size_t& posls )
 {
-    return skipUntil( [ &delims ](char c){ 
-        if(delims.find( c ) != std::string::npos) // char found
-            return true;
-        return false;        
-    }, endls, posls );   
+    return skipUntil( CharSet( delims ), endls, posls );   
 }
 
 bool StackReader::skipUntil( std::function< bool(char) > delimCallback, 
                              size_t& endlines, size_t& posInLine ) 
+{
+    return skipUntilPred( delimCallback, endlines, posInLine, std::false_type() );
+}
+
+bool StackReader::skipUntil( const CharSet& delims, size_t& endlines, size_t& posInLine ) 
 {
     if(!readable)
         return false;
     
-    char* lastEndlPos = stackPtr;
+    const char* lastEndlPos = stackPtr;
     size_t originalEndlines = endlines;
     while(1){
-        while(stackPtr < stackEnd){
-            char c = *( stackPtr ); // Get a character at current stack pointer position.
+        const char* found = ScanTools::findFirstOf( stackPtr, stackEnd, delims );
 
-            if(c == '\n'){
-                ++endlines;
-                lastEndlPos = stackPtr;
-            }
-            if( delimCallback( c ) ){ // Deliminating character occured now.
-                posInLine = ( endlines==originalEndlines ? 
-                              posInLine + (size_t)(stackPtr - lastEndlPos) :
-                              (size_t)(stackPtr - lastEndlPos) ); 
-                return true;
-            }
+        // Count the newlines skipped, and the delimiter itself if it's a newline.
+        endlines += ScanTools::countNewlines( stackPtr, 
+                        ( found < stackEnd ? found + 1 : found ), lastEndlPos );
+        stackPtr = (char*)found;
 
-            ++stackPtr;
+        if( stackPtr < stackEnd ){ // Deliminating character occured now.
+            posInLine = ( endlines==originalEndlines ? 
+                          posInLine + (size_t)(stackPtr - lastEndlPos) :
+                          (size_t)(stackPtr - lastEndlPos) ); 
+            return true;
         }
         
         // Calculate current position after endline, to setup new, adapted for new stackPtr.
@@ -383,28 +1227,235 @@ bool StackReader::skipUntil( std::function< bool(char) > delimCallback,
 }
 
 
-bool StackReader::putChar( char c )
+/*! Appends bytes until the first of 'delims' to 'buf'. Delimiter is left 
+ *  unread. If no delimiter is found, all that's left is appended.
+ *  - Whole windows are scanned and appended at once, so once the 'buf' has
+ *    grown to the record size, reading doesn't allocate.
+ *  @return false if nothing could be read.
+ */ 
+bool StackReader::getStringUntilDelim( std::string& buf, const CharSet& delims )
+{
+    if( !readable || !checkSetReadable() )
+        return false;
+
+    while(1){
+        const char* found = ScanTools::findFirstOf( stackPtr, stackEnd, delims );
+        buf.append( stackPtr, (size_t)( found - stackPtr ) );
+        stackPtr = (char*)found;
+
+        if( found < stackEnd || !fetchBuffer() )
+            break;
+    }
+    return true;
+}
+
+bool StackReader::getStringUntilDelim( std::string& buf, const std::string& delims ){
+    return getStringUntilDelim( buf, CharSet( delims ) );
+}
+
+/*! Appends bytes to 'buf' until the first match of the 'regex' (syntax of
+ *  the DfaBuilder). The match is left unread.
+ *  - Automaton of the last regex is cached, so repeated calls don't rebuild it.
+ *  @return false if nothing could be read, or the regex is invalid.
+ */ 
+bool StackReader::getStringUntilRegex( std::string& buf, const std::string& regex )
 {
-    if(stackPtr <= stackBuffer){ // Full buffer
-        if( !ensureSpace(1, 0, true) ) // Reallocate data to a bigger one
+    if( !regexAutomaton || regexSource != regex ){
+        std::unique_ptr< DfaBuilder > builder( new DfaBuilder() );
+        if( !builder->addRule( 0, regex ) || !builder->build() )
             return false;
+
+        regexAutomaton = std::move( builder );
+        regexSource = regex;
     }
+    return getStringUntilMatch( buf, regexAutomaton->getTables() );
+}
+
+/*! Makes 'len' bytes from the current position a view, and consumes them.
+ *  Memory the view points to gets pinned.
+ */ 
+void StackReader::setView( View& view, size_t len )
+{
+    view.release();
+    view.ptr = stackPtr;
+    view.len = len;
+    stackPtr += len;
+
+    if( !len )
+        return;
+
+    if( !isWindowBorrowed() )
+        pinnedStack = true;
+    else if( currentChunk.data && windowBase == currentChunk.data )
+        pinnedChunk = true;
+
+    view.owner = this;
+    ++viewLeases;
+}
+
+/*! Called by the views when released. Once last one is released, memory 
+ *  they pinned gets freed or reused.
+ */ 
+void StackReader::releaseView()
+{
+    if( !viewLeases || --viewLeases )
+        return;
+
+    retiredBuffers.clear();
+    pinnedStack = false;
+    pinnedChunk = false;
+    for( auto& seg : segments )
+        seg.pinned = false;
+
+    // Their replacements are circulating already.
+    for( auto& chunk : heldChunks )
+        spareChunks.push_back( chunk.data );
+    heldChunks.clear();
+}
+
+size_t StackReader::activeViews() const {
+    return viewLeases;
+}
+
+/*! Takes up to 'sz' bytes as a view. Less is taken only if stream ends.
+ *  @return false if nothing could be read.
+ */ 
+bool StackReader::getView( View& view, size_t sz )
+{
+    view.release();
+    if( !readable || !checkSetReadable() )
+        return false;
+
+    while( currentLength() < sz ){
+        if( !fetchMore() )
+            break;
+    }
+
+    setView( view, std::min( sz, currentLength() ) );
+    return true;
+}
+
+/*! Takes bytes until the first of 'delims' as a view. Delimiter is left 
+ *  unread. If no delimiter is found, all that's left is taken.
+ *  @return false if nothing could be read.
+ */ 
+bool StackReader::getViewUntilDelim( View& view, const CharSet& delims )
+{
+    view.release();
+    if( !readable || !checkSetReadable() )
+        return false;
+
+    size_t len = 0;
+    while(1){
+        const char* found = ScanTools::findFirstOf( stackPtr + len, stackEnd, delims );
+        len = found - stackPtr;
+
+        if( found < stackEnd || !fetchMore() )
+            break;
+    }
+
+    setView( view, len );
+    return true;
+}
+
+bool StackReader::getViewUntilDelim( View& view, const std::string& delims ){
+    return getViewUntilDelim( view, CharSet( delims ) );
+}
+
+/*! Makes the stack writable, with at least 'sz' free bytes in front of
+ *  the stack pointer, for the bytes put back.
+ *  - If the unread data is there, and it's pinned by views or there's not 
+ *    enough space, it's put aside as a segment instead of being moved.
+ */ 
+bool StackReader::makeFrontSpace( size_t sz )
+{
+    bool enoughSpace = (size_t)(stackPtr - stackBuffer) >= sz;
+    if( stackPtr < stackEnd && ( pinnedStack || !enoughSpace ) ){
+        pushSegment( sz );
+        return true;
+    }
+
+    unpinStack();
+    if( !enoughSpace )
+        return ensureSpace( sz, 0, true );
+    return true;
+}
+
+bool StackReader::putChar( char c )
+{
+    if( !trackingPosition )
+        return putBackChar( c );
+
+    syncPosition();
+    bool put = putBackChar( c );
+    positionSyncPtr = stackPtr;
+    if( put )
+        unconsumePosition( 1 );
+    return put;
+}
+
+bool StackReader::putString( const char* str, size_t sz )
+{
+    if( !trackingPosition )
+        return putBackString( str, sz );
+
+    syncPosition();
+    bool put = putBackString( str, sz );
+    positionSyncPtr = stackPtr;
+    if( put )
+        unconsumePosition( sz );
+    return put;
+}
+
+bool StackReader::putBackChar( char c )
+{
+    READER_STAT( stats.putbackBytes++ );
+    if( isWindowBorrowed() ){
+        // Putting back the same byte we've just read - just move the pointer.
+        if( stackPtr > windowBase && *(stackPtr - 1) == c ){
+            --stackPtr;
+            historyStart = std::min( historyStart, stackPtr );
+            readable = true;
+            return true;
+        }
+        suspendWindow();
+    }
+    invalidateMarks();
+
+    if( !makeFrontSpace( 1 ) )
+        return false;
 
     *(--stackPtr) = c;
+    historyStart = stackPtr; // Bytes before are no longer a history.
+    READER_STAT( injectedBytes++ );
 
     readable = true;
     return true;
 }
 
-bool StackReader::putString( const char* str, size_t sz )
+bool StackReader::putBackString( const char* str, size_t sz )
 {
-    if( (stackPtr-sz) <= stackBuffer ){ // Full buffer
-        if( !ensureSpace(sz, 0, true) ) // Reallocate data to a bigger one
-            return false;
+    READER_STAT( stats.putbackBytes += sz );
+    if( isWindowBorrowed() ){
+        if( (size_t)(stackPtr - windowBase) >= sz && 
+            std::memcmp( stackPtr - sz, str, sz ) == 0 )
+        {
+            stackPtr -= sz;
+            historyStart = std::min( historyStart, stackPtr );
+            readable = true;
+            return true;
+        }
+        suspendWindow();
     }
+    invalidateMarks();
+
+    if( !makeFrontSpace( sz ) )
+        return false;
 
     stackPtr -= sz;
     std::memmove( stackPtr, str, sz );
+    historyStart = stackPtr;
+    READER_STAT( injectedBytes += sz );
     
     readable = true;
     return true;
@@ -414,18 +1465,92 @@ bool StackReader::putString( const std::string& str ){
     return putString( str.c_str(), str.size() );
 }
 
-// TODO:
+/*! Moves back by 'sz' already consumed bytes - no copying is done.
+ *  - Possible only while the bytes are in the history. At least the last
+ *    'historySize' bytes are there, unless bytes were put back after them.
+ *  @return true if unread.
+ */ 
 bool StackReader::unRead( size_t sz )
 {
-    // Possible to safely unread only if no relocations were made in past 'sz'-long reads.
-    /*if( movesAfterRelocation >= sz && (stackPtr - stackBuffer >= sz) ){
-        stackPtr -= sz;
-        return true;
-    }*/
-    return false;
+    if( (size_t)(stackPtr - historyStart) < sz )
+        return false;
+
+    if( trackingPosition )
+        syncPosition();
+    stackPtr -= sz;
+    if( trackingPosition )
+        unconsumePosition( sz );
+    if( sz )
+        readable = true;
+    return true;
 }
- 
 
+/*! Sets a checkpoint on the current position. While it's active, all 
+ *  bytes from it onward are kept, so that reader could be rewound to it.
+ *  - Marks can be nested. Rewinding or committing the mark also releases
+ *    the ones set after it.
+ *  @return mark's handle.
+ */ 
+size_t StackReader::mark()
+{
+    if( trackingPosition )
+        syncPosition();
+    marks.push_back( stackPtr );
+    markPositions.push_back( syncedPosition );
+    return marks.size() - 1;
+}
 
+/*! Moves back to the position of the mark, and releases it.
+ *  @return false if mark is not active, or was invalidated by putting 
+ *          other bytes back.
+ */ 
+bool StackReader::rewind( size_t mark )
+{
+    if( mark >= marks.size() )
+        return false;
+
+    char* pos = marks[ mark ];
+    Position markPosition = markPositions[ mark ];
+    marks.resize( mark );
+    markPositions.resize( mark );
+    if( !pos )
+        return false;
+
+    stackPtr = pos;
+    if( trackingPosition ){
+        syncedPosition = markPosition;
+        positionSyncPtr = stackPtr;
+    }
+    if( stackPtr < stackEnd )
+        readable = true;
+    return true;
 }
 
+/*! Releases the mark and all the ones set after it, staying at the current
+ *  position.
+ *  @return false if mark is not active.
+ */ 
+bool StackReader::commit( size_t mark )
+{
+    if( mark >= marks.size() )
+        return false;
+
+    marks.resize( mark );
+    markPositions.resize( mark );
+    return true;
+}
+
+size_t StackReader::activeMarks() const {
+    return marks.size();
+}
+
+/*! Putting back other bytes overwrites the marked ones - marks which can't
+ *  be rewound to anymore get invalidated. They still must be released.
+ */ 
+void StackReader::invalidateMarks()
+{
+    for( auto& mark : marks )
+        mark = nullptr;
+}
+
+}
@@ -6,15 +6,89 @@
 #include <string>
 #include <functional>
 #include <cstring>
+#include <type_traits>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include "charclass.hpp"
+#include "scantools.hpp"
+#include "bytesource.hpp"
+#include "blockingqueue.hpp"
 
 namespace gtools{
 
+class DfaBuilder;
+
 class StackReader{
+public:
+    // Line and column of the next byte, both 0-based. Column is in bytes.
+    struct Position{
+        size_t line = 0;
+        size_t column = 0;
+    };
+
+    // Instrumentation counters, kept only if the library is built with the
+    // GTOOLS_READER_STATS defined (WITH_READER_STATS=yes). Otherwise all are 0.
+    struct Stats{
+        uint64_t bytesConsumed = 0;  // Read by the getters. Bytes put back count again.
+        uint64_t bytesRead = 0;      // Taken from the source.
+        uint64_t refills = 0;        // fetchBuffer() and fetchMore() calls.
+        uint64_t shortReads = 0;     // Source reads which gave less than asked.
+        uint64_t reallocations = 0;  // New stack buffers - growth, putback segments, unpinning.
+        uint64_t movedBytes = 0;     // Moved or copied within the reader to keep data contiguous.
+        uint64_t putbackBytes = 0;
+        uint64_t blockedNanos = 0;   // Waiting for the source's reads (or the prefetcher).
+    };
+
 protected:
-    const bool use_C;
+    // Source of the data. Sources created by the reader are owned by it.
+    ByteSource* source = nullptr;
+    std::unique_ptr< ByteSource > ownedSource;
+
+    // Start of the borrowed read window (direct source or prefetched chunk), or
+    // nullptr if reading from the stack buffer. While the overlay is being
+    // read, the borrowed window is suspended.
+    char* windowBase = nullptr;
+    char* suspendedPtr = nullptr;
+    char* suspendedEnd = nullptr;
 
-    std::istream& iStream;
-    FILE* cStream = nullptr;
+    // Prefetching - a background thread reads chunks of 'fileReadSize' while
+    // the current one is parsed. Chunks are swapped in as borrowed windows.
+    struct PrefetchChunk{
+        char* data;
+        long size;
+    };
+    std::unique_ptr< char[] > prefetchMemory;
+    std::thread prefetchThread;
+
+    // Queues are created by startPrefetch(), so that readers which don't
+    // prefetch don't allocate them.
+    struct PrefetchQueues{
+        BlockingQueue< PrefetchChunk > freeChunks;
+        BlockingQueue< PrefetchChunk > filledChunks;
+    };
+    std::unique_ptr< PrefetchQueues > prefetchQueues;
+    PrefetchChunk currentChunk = { nullptr, 0 };
+    bool prefetching = false;
+
+    // Views pin the memory they point to. While any view is alive, pinned 
+    // stack is replaced instead of overwritten, and pinned chunk is held 
+    // instead of given back. Both are freed once all views are released.
+    // Held chunk is replaced by a spare one, so that the prefetcher keeps
+    // the same count of chunks - released held chunks become the spares.
+    size_t viewLeases = 0;
+    bool pinnedStack = false;
+    bool pinnedChunk = false;
+    std::vector< std::unique_ptr< char[] > > retiredBuffers;
+    std::vector< PrefetchChunk > heldChunks;
+    std::vector< char* > spareChunks;
+    std::vector< std::unique_ptr< char[] > > extraChunks;
+    size_t prefetchChunks = 0;
 
     // The stack consists of 2 parts - the filereaded buffer, and the
     // priority buffer - extra space for storing putback'd bytes.
@@ -23,26 +97,132 @@ protected:
     
     char* stackBuffer = nullptr;
 
+    // Segments of the stack put aside by large putbacks, read after the 
+    // current stack, last one first. Segment's buffer is owned, like the
+    // stack's one, and 'pinned' if views point to it.
+    struct StackSegment{
+        char* buffer;
+        size_t size;
+        char* ptr;
+        char* end;
+        bool pinned;
+    };
+    std::vector< StackSegment > segments;
+    char* spareStack = nullptr;
+    size_t spareSize = 0;
+
+    // Storage of the derived class (StaticStackReader) used as the initial
+    // stack. It's never freed, and once replaced by the grown stack, it's
+    // never written to again.
+    char* inlineStack = nullptr;
+
     size_t fileReadSize = DEFAULT_READBUFFER;
+    size_t priorityStackSize;
     size_t stackSize;
     char* stackPtr;
     char* stackEnd;
 
+    // Already consumed bytes [historyStart, stackPtr) are still valid, and 
+    // can be unread. Refills keep at least 'historySize' of them.
+    char* historyStart;
+    size_t historySize = 0;
+
+    // Positions of the active marks, nested ones last. Null if invalidated.
+    std::vector< char* > marks;
+    std::vector< Position > markPositions;
+
+    // Lazy position tracking - bytes before 'positionSyncPtr' are counted in
+    // the 'syncedPosition'. Rest is counted when the window changes, or the
+    // position is asked for.
+    bool trackingPosition = false;
+    char* positionSyncPtr = nullptr;
+    Position syncedPosition;
+
+    // Automaton of the last regex passed to getStringUntilRegex().
+    std::unique_ptr< DfaBuilder > regexAutomaton;
+    std::string regexSource;
+
     bool readable = true;
     bool streamReadable = true;
+    bool blocked = false;
+
+    Stats stats;
+
+    // Bytes which got to the buffer not from the source - copied putbacks,
+    // and the ones buffered at the stats' reset.
+    uint64_t injectedBytes = 0;
 
     void setupStack();
+    void freeStack( char* buffer );
+    void setupFileSource( int fd, bool ownsFd );
+    bool isWindowBorrowed() const;
+    void suspendWindow();
+    void prefetchLoop();
+    PrefetchChunk takeFilledChunk();
+    bool fetchPrefetched();
+    void releaseCurrentChunk();
+    long sourceRead( char* buff, size_t len );
+    bool sourceRegion( const char*& region, size_t& regionLen );
+    long readNext( char* buff, size_t len );
+    void placeKept( char* keepFrom, size_t keepLen );
+    char* retentionPoint( char* keepFrom ) const;
+    bool nextWindow();
+    bool refill( char* keepFrom );
+    bool refillStack( char* keepFrom );
     bool fetchBuffer();
+    bool fetchMore();
+    void retireBuffer( char* buffer, bool pinned );
+    void retireStack();
+    void pushSegment( size_t frontSpace );
+    void popSegment();
+    void releaseSegment( char* buffer, size_t size, bool pinned );
+    void unpinStack();
+    void invalidateMarks();
     bool ensureSpace( size_t frontSpace, size_t backSpace, bool moveAllowed = true );
-    inline bool checkSetReadable();
+    bool makeFrontSpace( size_t sz );
+    bool putBackChar( char c );
+    bool putBackString( const char* str, size_t sz );
+    void syncPosition();
+    void unconsumePosition( size_t sz );
+    bool skipUntilSet( const CharSet& delims );
+    size_t copyString( char* st, size_t sz );
+    bool refillSlow();
+    size_t bufferedLength() const;
+
+    // Fast path is just a pointer compare - refills are done out of line.
+    bool checkSetReadable(){
+        return stackPtr < stackEnd || refillSlow();
+    }
+
+    template< typename Pred >
+    bool skipUntilPred( Pred& delimPred, size_t& endls, size_t& posls, std::true_type ){
+        return skipUntil( Pred::set, endls, posls );
+    }
+
+    template< typename Pred >
+    bool skipUntilPred( Pred& delimPred, size_t& endls, size_t& posls, std::false_type );
+
+    template< typename T >
+    bool getNumber( T& value, int skipmode, const char* (*parse)( const char*, const char*, T& ) );
 
     const static int STACK_REALLOC_SPACE_FRONT = 1;
     const static int STACK_REALLOC_SPACE_BACK  = 2;
 
+public:
+    class View;
+
+protected:
+    void setView( View& view, size_t len );
+    void releaseView();
+
+    // Reader using the 'storage' of 'prioritySize + bufferSize' as the stack.
+    StackReader( ByteSource& src, char* storage, size_t prioritySize, size_t bufferSize );
+
 public:
     const static size_t DEFAULT_READBUFFER = 256;
     const static size_t DEFAULT_PRIORITY_STACK = 256; 
     const static size_t DEFAULT_GROWTH = 256; 
+    const static size_t DEFAULT_PREFETCH_CHUNKS = 2; 
 
     const static int SKIPMODE_NOSKIP = 0;
     const static int SKIPMODE_SKIPWS = 1;
@@ -54,19 +234,85 @@ public:
     StackReader( FILE* inp, size_t prioritySize = DEFAULT_PRIORITY_STACK, 
                             size_t bufferSize = DEFAULT_READBUFFER );
 
+    // Memory-mapped constructors. If the file can't be mapped (e.g. it's a
+    // pipe), the reader falls back to reading 'bufferSize' chunks from it.
+    StackReader( const char* filePath, size_t prioritySize = DEFAULT_PRIORITY_STACK, 
+                                       size_t bufferSize = DEFAULT_READBUFFER );
+
+    StackReader( int fd, size_t prioritySize = DEFAULT_PRIORITY_STACK, 
+                         size_t bufferSize = DEFAULT_READBUFFER );
+
+    // Source is not owned - it must outlive the reader.
+    StackReader( ByteSource& src, size_t prioritySize = DEFAULT_PRIORITY_STACK, 
+                                  size_t bufferSize = DEFAULT_READBUFFER );
+
+    // Reader takes ownership of the source.
+    StackReader( std::unique_ptr< ByteSource > src, size_t prioritySize = DEFAULT_PRIORITY_STACK, 
+                                                    size_t bufferSize = DEFAULT_READBUFFER );
+
+    StackReader( std::function< long(char*, size_t) > readCallback, 
+                 size_t prioritySize = DEFAULT_PRIORITY_STACK, 
+                 size_t bufferSize = DEFAULT_READBUFFER );
+
     virtual ~StackReader();
 
-    bool isReadable();
+    bool isReadable(){
+        return readable && checkSetReadable();
+    }
     size_t getFrontSize() const;
     size_t getBackSize() const;
     size_t currentLength() const;
+    bool isDirect() const;
+
+    // Position is tracked only if enabled - from the current byte, as line 0
+    // and column 0. Consumed bytes are then counted in bulk, by the windows.
+    void setPositionTracking( bool enabled );
+    bool isTrackingPosition() const;
+    Position position();
+
+    // Size of the consumed bytes' history, kept across refills for unRead().
+    void setHistorySize( size_t size );
+    size_t getHistorySize() const;
+
+    // Starts a background thread which reads the stream ahead. After that,
+    // the stream must not be used by anyone else, until reader is destroyed.
+    // Refused for the non-blocking sources.
+    bool startPrefetch( size_t chunkCount = DEFAULT_PREFETCH_CHUNKS );
+    bool isPrefetching() const;
+
+    // Chunks allocated for prefetching, including the ones added while
+    // views held others.
+    size_t getPrefetchChunkCount() const;
+
+    // Last read failed because the non-blocking source had no data yet. The
+    // reader is not at the end - reads succeed again once more data arrives.
+    bool wouldBlock() const;
+
+    static bool statsEnabled();
+    Stats getStats() const;
+    void resetStats();
+
+    bool getChar( char& chr ){
+        if( !checkSetReadable() )
+            return false;
+        chr = *( stackPtr++ );
+        return true;
+    }
 
-    bool getChar( char& chr );
     bool getChar( char& c, int skipmode );
     bool getChar( char& c, int skipmode, size_t& endlines, size_t& posInLine );
 
-    int getChar();
-    int peekChar();
+    int getChar(){
+        if( !checkSetReadable() )
+            return -1;
+        return *( stackPtr++ );
+    }
+
+    int peekChar(){
+        if( !checkSetReadable() )
+            return -1;
+        return *( stackPtr );
+    }
 
     // Simply read char on stack pointer, no checking whatsoever.
     void getCharUnsafe( char& chr ) {   
@@ -83,24 +329,457 @@ public:
     size_t getString( char* st, size_t sz, int skipmode = SKIPMODE_NOSKIP );
     size_t getString( char* st, size_t sz, int skipmode, size_t& endlines, size_t& posInLine );
 
+    // Numbers are parsed in place from the buffer, independent of the locale.
+    // If there's no number (or it overflows), nothing is consumed.
+    bool getInt64( int64_t& value, int skipmode = SKIPMODE_NOSKIP );
+    bool getUInt64( uint64_t& value, int skipmode = SKIPMODE_NOSKIP );
+    bool getDouble( double& value, int skipmode = SKIPMODE_NOSKIP );
+
     bool skipWhitespace( int skipmode = SKIPMODE_SKIPWS );
     bool skipWhitespace( int skipmode, size_t& endlines, size_t& posInLine );
     bool skipUntil( std::function< bool(char) > delimCbk, size_t& endls, size_t& posls ); 
+    bool skipUntil( const CharSet& delims, size_t& endls, size_t& posls ); 
+
+    // Predicate gets inlined into the scanning loop. For compile-time char
+    // classes (CharClass, CharRange, CharUnion) the vectorized scan is used.
+    template< typename Pred >
+    bool skipUntil( Pred delimPred, size_t& endls, size_t& posls ){
+        return skipUntilPred( delimPred, endls, posls, 
+                              std::is_base_of< CharClassTag, Pred >() );
+    }
 
     bool skipUntilChar( char chr );
     bool skipUntilChar( char chr, size_t& endls, size_t& posls );
     bool skipUntilDelim( const std::string& delims );
     bool skipUntilDelim( const std::string& delims, size_t& endls, size_t& posls );
 
-    //bool getStringUntilDelim( std::string& buf, const std::string& delim );
-    //bool getStringUntilRegex( std::string& buf, const std::string& regex );
+    // Append to the 'buf', so clearing it between calls reuses its capacity.
+    bool getStringUntilDelim( std::string& buf, const CharSet& delims );
+    bool getStringUntilDelim( std::string& buf, const std::string& delims );
+    bool getStringUntilRegex( std::string& buf, const std::string& regex );
+
+    template< typename Automaton >
+    bool getStringUntilMatch( std::string& buf, const Automaton& dfa );
+
+    // Zero-copy reading - views point straight into the reader's memory.
+    bool getView( View& view, size_t sz );
+    bool getViewUntilDelim( View& view, const CharSet& delims );
+    bool getViewUntilDelim( View& view, const std::string& delims );
+
+    template< typename Pred >
+    bool getViewWhile( View& view, Pred pred );
+
+    template< typename Scanner >
+    bool getViewScanned( View& view, Scanner scan );
+
+    template< typename Automaton, typename State >
+    bool getViewLongest( View& view, const Automaton& dfa, State& acceptState );
+
+    size_t activeViews() const;
+
+    // Checkpoints for speculative parsing. Rewinding is just a pointer reset.
+    size_t mark();
+    bool rewind( size_t mark );
+    bool commit( size_t mark );
+    size_t activeMarks() const;
 
     bool putChar( char c );
     bool unRead( size_t sz );
     bool putString( const char* str, size_t sz );
     bool putString( const std::string& str );
+
+    // Input range over the unread bytes. Iterating consumes them.
+    class Iterator;
+    Iterator begin();
+    Iterator end();
+};
+
+/*! Input iterator over the reader's bytes, e.g. for( char c : reader ), or
+ *  std::find_if( reader.begin(), reader.end(), pred ).
+ *  - Dereferencing gives the current byte, without consuming it. Compare
+ *    with end() first - comparison is what refills the buffer.
+ *  - All copies share the reader's position, as with istreambuf_iterator.
+ */ 
+class StackReader::Iterator{
+private:
+    StackReader* rdr = nullptr;
+
+    bool atEnd() const {
+        return !rdr || !rdr->checkSetReadable();
+    }
+
+public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef char value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const char* pointer;
+    typedef char reference;
+
+    // Value of the byte before the increment, for *it++.
+    class Proxy{
+    private:
+        char c;
+    public:
+        explicit Proxy( char chr ) : c( chr ) {}
+        char operator*() const { return c; }
+    };
+
+    Iterator() {}
+    explicit Iterator( StackReader* reader ) : rdr( reader ) {}
+
+    char operator*() const { return *( rdr->stackPtr ); }
+
+    Iterator& operator++(){
+        ++( rdr->stackPtr );
+        return *this;
+    }
+
+    Proxy operator++( int ){
+        return Proxy( *( rdr->stackPtr++ ) );
+    }
+
+    // Iterators are equal if both are at the end, or share the reader.
+    bool operator==( const Iterator& other ) const {
+        bool end = atEnd();
+        bool otherEnd = other.atEnd();
+        return end == otherEnd && ( end || rdr == other.rdr );
+    }
+
+    bool operator!=( const Iterator& other ) const {
+        return !( *this == other );
+    }
+};
+
+inline StackReader::Iterator StackReader::begin(){
+    return Iterator( this );
+}
+
+inline StackReader::Iterator StackReader::end(){
+    return Iterator();
+}
+
+/*! View of the bytes already read, pointing straight into the reader's memory.
+ *  - While view is alive, the memory it points to is not moved nor freed.
+ *  - Views are move-only, and must not outlive the reader.
+ */ 
+class StackReader::View{
+private:
+    StackReader* owner = nullptr;
+    const char* ptr = nullptr;
+    size_t len = 0;
+
+    friend class StackReader;
+
+public:
+    View() {}
+    View( const View& ) = delete;
+    View& operator=( const View& ) = delete;
+
+    View( View&& other ) : owner( other.owner ), ptr( other.ptr ), len( other.len ) {
+        other.owner = nullptr;
+        other.ptr = nullptr;
+        other.len = 0;
+    }
+
+    View& operator=( View&& other ){
+        if( this != &other ){
+            release();
+            owner = other.owner;
+            ptr = other.ptr;
+            len = other.len;
+            other.owner = nullptr;
+            other.ptr = nullptr;
+            other.len = 0;
+        }
+        return *this;
+    }
+
+    ~View(){
+        release();
+    }
+
+    // Unpins the memory. View becomes empty.
+    void release(){
+        if( owner )
+            owner->releaseView();
+        owner = nullptr;
+        ptr = nullptr;
+        len = 0;
+    }
+
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+
+    const char* begin() const { return ptr; }
+    const char* end() const { return ptr + len; }
+    char operator[]( size_t i ) const { return ptr[i]; }
+
+    std::string str() const { return std::string( ptr, len ); }
+
+    bool equals( const char* str, size_t sz ) const {
+        return sz == len && std::memcmp( ptr, str, sz ) == 0;
+    }
+    bool operator==( const std::string& str ) const { return equals( str.c_str(), str.size() ); }
+    bool operator==( const char* str ) const { return equals( str, std::strlen( str ) ); }
+    bool operator!=( const std::string& str ) const { return !( *this == str ); }
+    bool operator!=( const char* str ) const { return !( *this == str ); }
 };
 
+/*! Takes bytes from the current position while they satisfy the 'pred'.
+ *  @return false if nothing could be read.
+ */ 
+template< typename Pred >
+bool StackReader::getViewWhile( View& view, Pred pred )
+{
+    view.release();
+    if( !isReadable() )
+        return false;
+
+    // Don't consume until done, so that fetchMore() keeps the bytes.
+    size_t len = 0;
+    while(1){
+        const char* p = stackPtr + len;
+        while( p < stackEnd && pred( *p ) )
+            ++p;
+
+        len = p - stackPtr;
+        if( p < stackEnd || !fetchMore() )
+            break;
+    }
+
+    setView( view, len );
+    return true;
+}
+
+/*! Takes bytes as a view, until the 'scan' finds its end. Scanner gets the 
+ *  part of the window not scanned yet, [begin, end), and returns where the 
+ *  view ends, or 'end' to go on in more data. Data may be moved between the
+ *  calls, so state it keeps must not point into it.
+ *  @return false if nothing could be read.
+ */ 
+template< typename Scanner >
+bool StackReader::getViewScanned( View& view, Scanner scan )
+{
+    view.release();
+    if( !isReadable() )
+        return false;
+
+    size_t len = 0;
+    while(1){
+        const char* found = scan( (const char*)stackPtr + len, (const char*)stackEnd );
+        len = found - stackPtr;
+
+        if( found < stackEnd || !fetchMore() )
+            break;
+    }
+
+    setView( view, len );
+    return true;
+}
+
+/*! Runs the automaton from the current position, and takes the longest 
+ *  accepted match as a view. Bytes after the match are left unread.
+ *  - Automaton must provide start(), step(state, char) returning 0 for the
+ *    dead state, and accepts(state).
+ *  @param acceptState - state the match was accepted in.
+ *  @return false if no non-empty match (nothing is consumed), or no data.
+ */ 
+template< typename Automaton, typename State >
+bool StackReader::getViewLongest( View& view, const Automaton& dfa, State& acceptState )
+{
+    view.release();
+    if( !isReadable() )
+        return false;
+
+    State state = dfa.start();
+    size_t len = 0, acceptLen = 0;
+    while(1){
+        const char* p = stackPtr + len;
+        for( ; p < stackEnd; ++p ){
+            state = dfa.step( state, *p );
+            if( !state )
+                break;
+            if( dfa.accepts( state ) ){
+                acceptLen = (size_t)(p - stackPtr) + 1;
+                acceptState = state;
+            }
+        }
+
+        len = p - stackPtr;
+        if( p < stackEnd || !fetchMore() )
+            break;
+    }
+
+    if( !acceptLen )
+        return false;
+
+    setView( view, acceptLen );
+    return true;
+}
+
+/*! Appends bytes to 'buf' until the first position where the automaton 
+ *  matches (as in getViewLongest). The match is left unread. If there's no 
+ *  match, all that's left is appended.
+ *  - Input is scanned once. Matches in progress are kept as the automaton's 
+ *    states with their start offsets. Starts reaching the same state match 
+ *    the same from there, so only the earliest one is kept - at most one 
+ *    per state, however long the partial matches get.
+ *  - Bytes before the earliest start in progress are appended before more 
+ *    is fetched, so only the possible match is kept in the buffer.
+ *  @return false if nothing could be read.
+ */ 
+template< typename Automaton >
+bool StackReader::getStringUntilMatch( std::string& buf, const Automaton& dfa )
+{
+    typedef decltype( dfa.start() ) State;
+    typedef std::pair< State, size_t > Partial;
+
+    if( !isReadable() )
+        return false;
+
+    // Bytes the match can start with. Others are skipped by the vectorized scan.
+    CharSet firstBytes;
+    const State start = dfa.start();
+    for( int c = 0; c < 256; c++ ){
+        if( dfa.step( start, (char)c ) )
+            firstBytes.add( (char)c );
+    }
+
+    auto addPartial = []( std::vector< Partial >& partials, State state, size_t from ){
+        for( auto& part : partials ){
+            if( part.first == state ){
+                part.second = std::min( part.second, from );
+                return;
+            }
+        }
+        partials.emplace_back( state, from );
+    };
+
+    // Offsets are from the stackPtr. Accepted match is final once no earlier
+    // start is in progress.
+    std::vector< Partial > live, next;
+    bool matched = false;
+    size_t matchStart = 0;
+    size_t pos = 0;
+
+    while(1){
+        if( live.empty() ){
+            if( matched )
+                break;
+
+            // Bytes stepped through are ruled out - skip from after them.
+            buf.append( stackPtr, pos );
+            stackPtr += pos;
+
+            const char* found = ScanTools::findFirstOf( stackPtr, stackEnd, firstBytes );
+            buf.append( stackPtr, (size_t)( found - stackPtr ) );
+            stackPtr = (char*)found;
+            pos = 0;
+
+            if( stackPtr >= stackEnd ){
+                if( !fetchBuffer() )
+                    break;
+                continue;
+            }
+        }
+
+        if( stackPtr + pos >= stackEnd ){
+            size_t keep = ( matched ? matchStart : pos );
+            for( const auto& part : live )
+                keep = std::min( keep, part.second );
+
+            buf.append( stackPtr, keep );
+            stackPtr += keep;
+            pos -= keep;
+            matchStart -= ( matched ? keep : 0 );
+            for( auto& part : live )
+                part.second -= keep;
+
+            if( !fetchMore() ){
+                // Partial matches can't complete.
+                live.clear();
+                if( !matched ){
+                    buf.append( stackPtr, (size_t)( stackEnd - stackPtr ) );
+                    stackPtr = stackEnd;
+                    break;
+                }
+            }
+            continue;
+        }
+
+        char c = stackPtr[ pos ];
+        next.clear();
+        for( const auto& part : live ){
+            State state = dfa.step( part.first, c );
+            if( state )
+                addPartial( next, state, part.second );
+        }
+        if( !matched ){
+            State state = dfa.step( start, c );
+            if( state )
+                addPartial( next, state, pos );
+        }
+        ++pos;
+
+        // Earliest accepted start wins - later starts are dropped.
+        for( const auto& part : next ){
+            if( dfa.accepts( part.first ) && ( !matched || part.second < matchStart ) ){
+                matched = true;
+                matchStart = part.second;
+            }
+        }
+        if( matched ){
+            next.erase( std::remove_if( next.begin(), next.end(), [&]( const Partial& part ){
+                return part.second >= matchStart; } ), next.end() );
+        }
+        live.swap( next );
+    }
+
+    if( matched ){
+        buf.append( stackPtr, matchStart );
+        stackPtr += matchStart;
+    }
+    return true;
+}
+
+template< typename Pred >
+bool StackReader::skipUntilPred( Pred& delimPred, size_t& endlines, size_t& posInLine, 
+                                 std::false_type )
+{
+    if(!readable)
+        return false;
+    
+    const char* lastEndlPos = stackPtr;
+    size_t originalEndlines = endlines;
+    while(1){
+        for( ; stackPtr < stackEnd; ++stackPtr ){
+            char c = *( stackPtr ); 
+
+            if(c == '\n'){
+                ++endlines;
+                lastEndlPos = stackPtr;
+            }
+            if( delimPred( c ) ){ // Deliminating character occured now.
+                posInLine = ( endlines==originalEndlines ? 
+                              posInLine + (size_t)(stackPtr - lastEndlPos) :
+                              (size_t)(stackPtr - lastEndlPos) ); 
+                return true;
+            }
+        }
+        
+        // Buffer exhausted - fetch new data, and adapt the line position to it.
+        size_t diff = stackPtr - lastEndlPos;
+        if( !fetchBuffer() )
+            break; 
+        lastEndlPos = stackPtr - diff; 
+    } 
+    posInLine = ( endlines==originalEndlines ? 
+                  posInLine + (size_t)(stackPtr - lastEndlPos) :
+                  (size_t)(stackPtr - lastEndlPos) );
+    return false;
+}
+
 }
 
 #endif // STACKREADER_HPP_INCLUDED
@@ -0,0 +1,57 @@
+#ifndef STATICSTACKREADER_HPP_INCLUDED
+#define STATICSTACKREADER_HPP_INCLUDED
+
+#include "stackreader.hpp"
+
+namespace gtools{
+
+/*! Storage of the StaticStackReader. It's a base class, so that it's
+ *  constructed before the StackReader which uses it.
+ */
+template< size_t StackSize >
+class StaticStackStorage{
+protected:
+    alignas( 64 ) char stackStorage[ StackSize ];
+    MemorySource memorySource;
+
+    StaticStackStorage() : memorySource( nullptr, 0 ) {}
+    StaticStackStorage( const char* data, size_t size ) : memorySource( data, size ) {}
+};
+
+/*! StackReader with the stack stored inline, instead of on the heap.
+ *  - Meant for the short-lived readers of small messages - reader created on
+ *    the stack (of the program) doesn't allocate at all, as long as the data
+ *    fits the buffer and no prefetching is started.
+ *  - Reading is done by the StackReader's code. If the stack has to grow
+ *    (long views, marks or history), the grown stack is allocated as usual.
+ */
+template< size_t PrioritySize = StackReader::DEFAULT_PRIORITY_STACK,
+          size_t BufferSize = StackReader::DEFAULT_READBUFFER >
+class StaticStackReader final : private StaticStackStorage< PrioritySize + BufferSize >,
+                                public StackReader
+{
+private:
+    typedef StaticStackStorage< PrioritySize + BufferSize > Storage;
+
+    static_assert( BufferSize > 0, "Buffer size must not be 0." );
+
+public:
+    const static size_t PRIORITY_SIZE = PrioritySize;
+    const static size_t BUFFER_SIZE = BufferSize;
+
+    // Source is not owned - it must outlive the reader.
+    explicit StaticStackReader( ByteSource& src )
+        : StackReader( src, Storage::stackStorage, PrioritySize, BufferSize ) {}
+
+    // Reads the memory in place, without copying.
+    StaticStackReader( const char* data, size_t size )
+        : Storage( data, size ),
+          StackReader( Storage::memorySource, Storage::stackStorage, PrioritySize, BufferSize ) {}
+
+    StaticStackReader( const StaticStackReader& ) = delete;
+    StaticStackReader& operator=( const StaticStackReader& ) = delete;
+};
+
+}
+
+#endif // STATICSTACKREADER_HPP_INCLUDED
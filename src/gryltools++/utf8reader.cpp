@@ -0,0 +1,144 @@
+#include "utf8reader.hpp"
+#include "scantools.hpp"
+
+namespace gtools{
+
+bool Utf8Reader::isSpace( char32_t cp )
+{
+    if( cp < 0x80 )
+        return ScanTools::isSpace( (char)cp );
+
+    return cp == 0x85 || cp == 0xA0 || cp == 0x1680 ||
+           ( cp >= 0x2000 && cp <= 0x200A ) || cp == 0x2028 || cp == 0x2029 ||
+           cp == 0x202F || cp == 0x205F || cp == 0x3000;
+}
+
+/*! Slow path of getCodepoint() - decodes the rest of the multibyte sequence.
+ *  Continuation bytes are only consumed if they fit, so that the invalid
+ *  sequence doesn't swallow the next character.
+ */
+bool Utf8Reader::getMultibyte( unsigned char lead, char32_t& cp )
+{
+    size_t len = sequenceLength( lead );
+    char bytes[4] = { (char)lead };
+
+    size_t got = 1;
+    while( got < len && reader.isReadable() ){
+        int c = reader.peekChar();
+        if( (c & 0xC0) != 0x80 )
+            break;
+        bytes[ got++ ] = (char)reader.getChar();
+    }
+
+    ++column;
+    if( got < len || !ScanTools::decodeUtf8( bytes, bytes + len, cp ) ){
+        cp = REPLACEMENT;
+        ++invalidCount;
+    }
+    return true;
+}
+
+/*! Advances the position over the valid UTF-8 in [begin, end).
+ */
+void Utf8Reader::advance( const char* begin, const char* end )
+{
+    const char* lastNewline = nullptr;
+    size_t newlines = ScanTools::countNewlines( begin, end, lastNewline );
+    if( newlines ){
+        line += newlines;
+        column = ScanTools::countCodepoints( lastNewline + 1, end );
+    }
+    else
+        column += ScanTools::countCodepoints( begin, end );
+}
+
+bool Utf8Reader::skipWhitespace()
+{
+    while(1){
+        // ASCII whitespace is skipped by the reader. Position it gives after
+        // a newline is the distance from it.
+        size_t lines = line, pos = column;
+        bool readable = reader.skipWhitespace( StackReader::SKIPMODE_SKIPWS, lines, pos );
+        column = ( lines != line ? pos - 1 : pos );
+        line = lines;
+
+        if( !readable )
+            return false;
+        if( !( reader.peekChar() & 0x80 ) )
+            return true;
+
+        // Multibyte space - read it, or leave the other character unread.
+        size_t m = reader.mark();
+        size_t oldColumn = column, oldInvalid = invalidCount;
+        char32_t cp;
+        getCodepoint( cp );
+
+        if( !isSpace( cp ) ){
+            reader.rewind( m );
+            column = oldColumn;
+            invalidCount = oldInvalid;
+            return true;
+        }
+        reader.commit( m );
+    }
+}
+
+bool Utf8Reader::validate()
+{
+    StackReader::View view;
+    while( reader.isReadable() ){
+        reader.getView( view, reader.currentLength() );
+        const char* bad = ScanTools::validateUtf8( view.begin(), view.end() );
+        advance( view.begin(), bad );
+        if( bad == view.end() )
+            continue;
+
+        // Put the rest back. Sequence cut by the window's end is completed
+        // by the next one.
+        reader.putString( bad, view.end() - bad );
+        view.release();
+
+        size_t m = reader.mark();
+        size_t oldColumn = column, oldInvalid = invalidCount;
+        char32_t cp;
+        getCodepoint( cp );
+
+        if( invalidCount != oldInvalid ){
+            reader.rewind( m );
+            column = oldColumn;
+            invalidCount = oldInvalid;
+            return false;
+        }
+        reader.commit( m );
+    }
+    return true;
+}
+
+bool Utf8Reader::getStringUntilDelim( std::string& buf, const std::string& delims )
+{
+    size_t from = buf.size();
+    if( !reader.getStringUntilDelim( buf, delims ) )
+        return false;
+
+    const char* p = buf.data() + from;
+    const char* end = buf.data() + buf.size();
+
+    // Invalid sequence is skipped as getMultibyte() consumes it - lead byte
+    // and the continuation bytes that fit, so it's one replacement character,
+    // counted once and taking one column.
+    while(1){
+        const char* invalid = ScanTools::validateUtf8( p, end );
+        advance( p, invalid );
+        if( invalid == end )
+            break;
+
+        size_t len = sequenceLength( (unsigned char)*invalid );
+        const char* last = ( (size_t)( end - invalid ) > len ? invalid + len : end );
+        for( p = invalid + 1; p < last && ( *p & 0xC0 ) == 0x80; ++p );
+        ++column;
+        ++invalidCount;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,79 @@
+#ifndef UTF8READER_HPP_INCLUDED
+#define UTF8READER_HPP_INCLUDED
+
+#include <string>
+#include "stackreader.hpp"
+
+/*! UTF-8 layer over the StackReader.
+ *  - Codepoints are decoded with the ASCII fast path inlined. Invalid
+ *    sequences are read as U+FFFD, and counted.
+ *  - Position is tracked as line and column, both 0-based. Columns are
+ *    counted in codepoints, lines by '\n's.
+ *  - Bulk operations (validate, getStringUntilDelim) skip the ASCII runs by
+ *    the vectorized ScanTools kernels, decoding only the multibyte sequences.
+ */
+
+namespace gtools{
+
+class Utf8Reader{
+private:
+    StackReader& reader;
+
+    size_t line = 0;
+    size_t column = 0;
+    size_t invalidCount = 0;
+
+    // Bytes of the sequence started by 'lead' - 1 if it's no lead byte.
+    static size_t sequenceLength( unsigned char lead ){
+        return ( lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1 );
+    }
+
+    bool getMultibyte( unsigned char lead, char32_t& cp );
+    void advance( const char* begin, const char* end );
+
+public:
+    const static char32_t REPLACEMENT = 0xFFFD;
+
+    Utf8Reader( StackReader& rdr ) : reader( rdr ) {}
+
+    // Unicode White_Space characters.
+    static bool isSpace( char32_t cp );
+
+    bool getCodepoint( char32_t& cp ){
+        char c;
+        if( !reader.getChar( c ) )
+            return false;
+        if( (unsigned char)c >= 0x80 )
+            return getMultibyte( (unsigned char)c, cp );
+
+        cp = (unsigned char)c;
+        if( c == '\n' ){
+            ++line;
+            column = 0;
+        }
+        else
+            ++column;
+        return true;
+    }
+
+    // Skips Unicode whitespace. @return false if input ended.
+    bool skipWhitespace();
+
+    /*! Consumes the input while it's valid UTF-8.
+     *  @return true if all of it was valid. Otherwise the invalid sequence
+     *          is left unread, at getLine() and getColumn().
+     */
+    bool validate();
+
+    // Appends bytes until the first of the ASCII 'delims', as the reader's
+    // getStringUntilDelim(). Invalid sequences are kept, and counted.
+    bool getStringUntilDelim( std::string& buf, const std::string& delims );
+
+    size_t getLine() const { return line; }
+    size_t getColumn() const { return column; }
+    size_t getInvalidCount() const { return invalidCount; }
+};
+
+}
+
+#endif // UTF8READER_HPP_INCLUDED
@@ -3,6 +3,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#if defined _GRYLTOOL_POSIX
+    #include <fcntl.h>
+#endif
+
 int gsockGetLastError()
 {
     #if defined _GRYLTOOL_WIN32
@@ -203,4 +207,29 @@ int gsockSend(SOCKET sock, const char* buff, size_t bufsize, int flags)
     return send(sock, buff, bufsize, flags);
 }
 
+int gsockSetBlocking(SOCKET sock, char blocking)
+{
+    #if defined _GRYLTOOL_WIN32
+        u_long mode = (blocking ? 0 : 1);
+        return (ioctlsocket(sock, FIONBIO, &mode) == 0 ? 0 : -1);
+    #elif defined _GRYLTOOL_POSIX
+        int fl = fcntl(sock, F_GETFL, 0);
+        if(fl < 0)
+            return -1;
+        fl = (blocking ? (fl & ~O_NONBLOCK) : (fl | O_NONBLOCK));
+        return (fcntl(sock, F_SETFL, fl) == 0 ? 0 : -1);
+    #endif // defined
+    return -1;
+}
+
+char gsockIsWouldBlock(int error)
+{
+    #if defined _GRYLTOOL_WIN32
+        return (error == WSAEWOULDBLOCK);
+    #elif defined _GRYLTOOL_POSIX
+        return (error == EAGAIN || error == EWOULDBLOCK);
+    #endif // defined
+    return 0;
+}
+
 
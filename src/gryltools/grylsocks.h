@@ -31,6 +31,10 @@
 
 #define GSOCK_DEFAULT_BUFLEN 1500
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /*! The socket data structure
  *  - Encapsulates a socket, a buffer of an initial size of GSOCK_DEFAULT_BUFLEN, and flags. 
  *  - Use for more convenience when transferring a buffer of each socket.
@@ -55,4 +59,13 @@ SOCKET gsockListenSocket(int port, const char* localBindAddr, int family, int so
 int gsockReceive(SOCKET sock, char* buff, size_t bufsize, int flags);
 int gsockSend(SOCKET sock, const char* buff, size_t bufsize, int flags); 
 
+/* Blocking mode of the socket. Returns 0 on success. */
+int gsockSetBlocking(SOCKET sock, char blocking);
+/* Whether the error (of gsockGetLastError()) means no data on a non-blocking socket. */
+char gsockIsWouldBlock(int error);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
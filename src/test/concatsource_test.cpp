@@ -0,0 +1,160 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <gryltools/concatsource.hpp>
+
+static bool debug = false;
+
+struct TestFiles{
+    std::string dir;
+    std::vector< std::string > paths;
+    std::vector< std::string > contents;
+
+    ~TestFiles(){
+        for( const auto& path : paths )
+            std::remove( path.c_str() );
+        std::remove( dir.c_str() );
+    }
+};
+
+// Files of varying sizes - empty ones, ones smaller and bigger than the head,
+// and one which doesn't exist.
+void makeFiles( TestFiles& files, size_t count ){
+    char dirTemplate[] = "/tmp/concatsource_test_XXXXXX";
+    assert( mkdtemp( dirTemplate ) );
+    files.dir = dirTemplate;
+
+    for( size_t i = 0; i < count; i++ ){
+        std::string path = files.dir + "/log." + std::to_string( i );
+        std::string content;
+        if( i % 7 != 3 ){
+            for( size_t j = 0; j < ( i * 13 ) % 120; j++ )
+                content += (char)( j % 10 == 9 ? '\n' : 'a' + (char)( (i + j) % 26 ) );
+        }
+
+        files.paths.push_back( path );
+        if( i == count / 2 ){
+            files.contents.push_back( "" ); // Missing.
+            continue;
+        }
+
+        FILE* file = std::fopen( path.c_str(), "wb" );
+        assert( file );
+        std::fwrite( content.data(), 1, content.size(), file );
+        std::fclose( file );
+        files.contents.push_back( content );
+    }
+}
+
+std::string concatenate( const std::vector< std::string >& contents ){
+    std::string all;
+    for( const auto& content : contents )
+        all += content;
+    return all;
+}
+
+void testSource( const TestFiles& files ){
+    // Small head - bigger files are read by the opened source too.
+    gtools::ConcatSource src( files.paths, 3, 16 );
+    gtools::StackReader rdr( src, 8, 32 );
+
+    std::string got;
+    for( char c : rdr )
+        got += c;
+    assert( got == concatenate( files.contents ) );
+    assert( src.getFailedCount() == 1 );
+    assert( src.getCurrentIndex() == files.paths.size() - 1 );
+}
+
+void testLocation( const TestFiles& files ){
+    gtools::ConcatReader rdr( files.paths, 8, 16 );
+
+    // Prefetching would move the source ahead of the reader - it's refused
+    // through the base class too.
+    gtools::StackReader& base = rdr;
+    assert( !base.startPrefetch() && !rdr.isPrefetching() );
+
+    size_t index;
+    uint64_t offset;
+    assert( !rdr.getLocation( index, offset ) );
+
+    // Location of each byte, checked when it's buffered.
+    for( size_t i = 0; i < files.contents.size(); i++ ){
+        for( size_t j = 0; j < files.contents[i].size(); j++ ){
+            assert( rdr.peekChar() == files.contents[i][j] );
+            assert( rdr.getLocation( index, offset ) );
+            if( debug && ( index != i || offset != j ) )
+                std::cout<<"[ Byte "<< j <<" of "<< i <<" located at "<< offset <<" of "<< index <<" ]\n";
+            assert( index == i && offset == j );
+            rdr.getChar();
+        }
+    }
+    assert( !rdr.isReadable() );
+
+    // Putting back moves the location back.
+    assert( rdr.putString( "xy" ) );
+    assert( rdr.getLocation( index, offset ) );
+    assert( index == files.contents.size() - 1 && offset == files.contents.back().size() - 2 );
+}
+
+void testStreams(){
+    const char* parts[] = { "first\n", "", "second\nthird", "\n" };
+    std::vector< std::unique_ptr< gtools::ByteSource > > sources;
+    for( const char* part : parts )
+        sources.emplace_back( new gtools::MemorySource( part, std::strlen( part ) ) );
+
+    gtools::ConcatReader rdr( std::move( sources ), 4, 4 );
+    std::string line;
+    assert( rdr.getStringUntilDelim( line, "\n" ) && line == "first" );
+    rdr.getChar();
+
+    line.clear();
+    assert( rdr.getStringUntilDelim( line, "\n" ) && line == "second" );
+    size_t index;
+    uint64_t offset;
+    assert( rdr.getLocation( index, offset ) && index == 2 && offset == 6 );
+
+    rdr.getChar();
+    line.clear();
+    assert( rdr.getStringUntilDelim( line, "\n" ) && line == "third" );
+    assert( rdr.getSource().getCurrentIndex() == 3 );
+    assert( rdr.getSource().getBytesRead() == 19 );
+}
+
+void testEarlyDestruction( const TestFiles& files ){
+    // Opener is waiting for the free slots - it must be stopped.
+    for( int i = 0; i < 20; i++ ){
+        gtools::ConcatReader rdr( files.paths, 8, 8, 1 );
+        rdr.getChar();
+    }
+    gtools::ConcatReader none( std::vector< std::string >{} );
+    assert( !none.isReadable() );
+}
+
+int main( int argc, char** argv ){
+    if( argc > 1 ){
+        if( !strcmp( argv[1], "-v") || !strcmp( argv[1], "--debug") ||
+            !strcmp( argv[1], "--verbose") )
+            debug = true;
+    }
+
+    std::cout<<"[ Testing gtools::ConcatSource] ... ";
+    if(debug) std::cout<<"\n";
+
+    TestFiles files;
+    makeFiles( files, 61 );
+
+    testSource( files );
+    testLocation( files );
+    testStreams();
+    testEarlyDestruction( files );
+
+    std::cout<<"[ Passed! ]\n";
+
+    return 0;
+}
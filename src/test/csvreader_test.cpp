@@ -0,0 +1,172 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <gryltools/csvreader.hpp>
+#include <gryltools/scantools.hpp>
+
+static bool debug = false;
+
+typedef std::vector< std::vector< std::string > > Records;
+
+// Reference - byte by byte. Every quote toggles the state.
+void indexReference( const char* p, const char* end, char delim, bool& inQuotes,
+                     std::vector< size_t >& structurals, size_t base ){
+    for( const char* start = p; p < end; p++ ){
+        if( *p == '"' )
+            inQuotes = !inQuotes;
+        else if( !inQuotes && ( *p == '\n' || *p == delim ) )
+            structurals.push_back( base + (size_t)( p - start ) );
+    }
+}
+
+void testIndexKernel(){
+    const char alphabet[] = "ab,\"\n";
+    std::string text;
+    for( int i = 0; i < 700; i++ )
+        text += alphabet[ rand() % ( i % 3 ? 3 : 5 ) ];
+    const char* data = text.data();
+
+    // All offsets, and both start states - vector paths and the tails.
+    for( size_t from = 0; from < 130; from++ ){
+        for( bool startQuoted : { false, true } ){
+            bool q1 = startQuoted, q2 = startQuoted;
+            std::vector< size_t > s1, s2;
+            gtools::ScanTools::indexDelimited( data + from, data + text.size(), ',', '"', q1, s1, 5 );
+            indexReference( data + from, data + text.size(), ',', q2, s2, 5 );
+            assert( q1 == q2 && s1 == s2 );
+        }
+    }
+
+    // Indexing in parts carries the state over.
+    for( size_t cut = 0; cut < 200; cut += 7 ){
+        bool q1 = false, q2 = false;
+        std::vector< size_t > s1, s2;
+        gtools::ScanTools::indexDelimited( data, data + cut, ',', '"', q1, s1, 0 );
+        gtools::ScanTools::indexDelimited( data + cut, data + text.size(), ',', '"', q1, s1, cut );
+        indexReference( data, data + text.size(), ',', q2, s2, 0 );
+        assert( q1 == q2 && s1 == s2 );
+    }
+}
+
+std::string randomField(){
+    static const char* words[] = { "alpha", "42", "3.14", "", "x y", "tail\r" };
+    std::string field = words[ rand() % 6 ];
+    switch( rand() % 6 ){
+        case 0: field += ",comma"; break;
+        case 1: field += "\"quoted\""; break;
+        case 2: field += "\nnew line"; break;
+        case 3: field += std::string( rand() % 150, 'v' ); break;
+        default: break;
+    }
+    return field;
+}
+
+// Quoted only when needed, so both the views and the unescaping are used.
+std::string serialize( const Records& records, char delim, bool crlf, bool lastNewline ){
+    std::string text;
+    for( size_t r = 0; r < records.size(); r++ ){
+        for( size_t f = 0; f < records[r].size(); f++ ){
+            const std::string& field = records[r][f];
+            if( f )
+                text += delim;
+            if( field.find_first_of( std::string( "\"\r\n" ) + delim ) == std::string::npos ){
+                text += field;
+                continue;
+            }
+            text += '"';
+            for( char c : field )
+                text += ( c == '"' ? std::string( "\"\"" ) : std::string( 1, c ) );
+            text += '"';
+        }
+        if( r + 1 < records.size() || lastNewline )
+            text += ( crlf ? "\r\n" : "\n" );
+    }
+    return text;
+}
+
+void checkRecords( gtools::StackReader& rdr, const Records& records, char delim ){
+    gtools::CsvReader csv( rdr, delim );
+    size_t r = 0;
+    while( csv.nextRecord() ){
+        assert( r < records.size() );
+        if( debug && csv.size() != records[r].size() )
+            std::cout<<"[ Record "<< r <<": "<< csv.size() <<" fields, expected "
+                     << records[r].size() <<" ]\n";
+        assert( csv.size() == records[r].size() );
+        for( size_t f = 0; f < csv.size(); f++ )
+            assert( csv[f] == records[r][f] );
+        assert( !csv.isUnterminated() );
+        r++;
+    }
+    assert( r == records.size() && csv.getRecordCount() == r );
+}
+
+void testRecords(){
+    // First ones span several batches.
+    for( int round = 0; round < 8; round++ ){
+        Records records( round < 2 ? 3000 : 300 );
+        for( auto& record : records ){
+            record.resize( 1 + rand() % 8 );
+            for( auto& field : record )
+                field = randomField();
+        }
+        records[7] = { "" }; // Empty line.
+        records.back() = { "end" };
+
+        char delim = ( round % 2 ? '\t' : ',' );
+        std::string text = serialize( records, delim, round % 3 == 0, round % 4 != 1 );
+        if(debug) std::cout<<"[ Round "<< round <<": "<< text.size() <<" bytes ]\n";
+
+        // Small buffers cut the records at every kind of place.
+        for( size_t bufSize : { (size_t)7, (size_t)64, (size_t)1000 } ){
+            std::istringstream iss( text, std::ios::in | std::ios::binary );
+            gtools::StackReader rdr( iss, 8, bufSize );
+            checkRecords( rdr, records, delim );
+        }
+
+        gtools::MemorySource src( text.data(), text.size() );
+        gtools::StackReader mrdr( src );
+        checkRecords( mrdr, records, delim );
+    }
+}
+
+void testMalformed(){
+    std::string text = "\"ab\"cd,\"e\"\"\"\r\nlast,\"open\nquote";
+    std::istringstream iss( text, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 4, 5 );
+    gtools::CsvReader csv( rdr );
+
+    assert( csv.nextRecord() && csv.size() == 2 );
+    assert( csv[0] == "abcd" && csv[1] == "e\"" && csv[1].quoted );
+    assert( csv.getRecord() == "\"ab\"cd,\"e\"\"\"\r" );
+
+    // Quote never closed - rest of the input is the last field.
+    assert( csv.nextRecord() && csv.size() == 2 );
+    assert( csv[0] == "last" && csv[1] == "open\nquote" );
+    assert( csv.isUnterminated() );
+    assert( !csv.nextRecord() );
+}
+
+int main( int argc, char** argv ){
+    if( argc > 1 ){
+        if( !strcmp( argv[1], "-v") || !strcmp( argv[1], "--debug") ||
+            !strcmp( argv[1], "--verbose") )
+            debug = true;
+    }
+
+    std::cout<<"[ Testing gtools::CsvReader   ] ... ";
+    if(debug) std::cout<<"\n";
+
+    srand( 7 );
+    testIndexKernel();
+    testRecords();
+    testMalformed();
+
+    std::cout<<"[ Passed! ]\n";
+
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+#include <gryltools/gzipsource.hpp>
+#include <gryltools/stackreader.hpp>
+
+static bool debug = false;
+
+std::string makeText( size_t lines ){
+    std::string text;
+    for( size_t i = 0; i < lines; i++ ){
+        text += "line " + std::to_string( i ) + " value=" + std::to_string( ( i * 7919 ) % 10007 );
+        for( size_t j = 0; j < i % 13; j++ )
+            text += (char)( 'a' + (char)( (i + j) % 26 ) );
+        text += '\n';
+    }
+    return text;
+}
+
+// One gzip member.
+std::string gzip( const std::string& data ){
+    z_stream strm;
+    std::memset( &strm, 0, sizeof( strm ) );
+    assert( deflateInit2( &strm, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY ) == Z_OK );
+
+    std::string out( deflateBound( &strm, data.size() ), '\0' );
+    strm.next_in = (unsigned char*)data.data();
+    strm.avail_in = (uInt)data.size();
+    strm.next_out = (unsigned char*)&out[0];
+    strm.avail_out = (uInt)out.size();
+    assert( deflate( &strm, Z_FINISH ) == Z_STREAM_END );
+    out.resize( out.size() - strm.avail_out );
+    deflateEnd( &strm );
+    return out;
+}
+
+std::unique_ptr< gtools::ByteSource > memorySource( const std::string& data ){
+    return std::unique_ptr< gtools::ByteSource >( new gtools::MemorySource( data.data(), data.size() ) );
+}
+
+std::string readAll( gtools::StackReader& rdr ){
+    std::string got;
+    for( char c : rdr )
+        got += c;
+    return got;
+}
+
+void testDecompress( const std::string& text, const std::string& compressed ){
+    // Small blocks and buffers cut the data at every kind of place.
+    for( bool threaded : { false, true } ){
+        for( size_t blockSize : { (size_t)1, (size_t)7, (size_t)4096,
+                                  gtools::GzipSource::DEFAULT_BLOCK_SIZE } ){
+            gtools::GzipSource src( memorySource( compressed ), threaded, blockSize );
+            gtools::StackReader rdr( src, 8, 64 );
+            std::string got = readAll( rdr );
+            if( debug && got != text )
+                std::cout<<"[ Threaded "<< threaded <<", block "<< blockSize <<": got "<< got.size()
+                         <<" of "<< text.size() <<" bytes ]\n";
+            assert( got == text );
+            assert( src.isCompressed() && !src.hasError() );
+        }
+    }
+}
+
+void testConcatenated( const std::string& text ){
+    // Members are decompressed one after the other.
+    std::string first = text.substr( 0, text.size() / 3 ), second = text.substr( text.size() / 3 );
+    std::string compressed = gzip( first ) + gzip( "" ) + gzip( second );
+    testDecompress( text, compressed );
+}
+
+void testPlain( const std::string& text ){
+    for( bool threaded : { false, true } ){
+        gtools::GzipSource src( memorySource( text ), threaded, 100 );
+        gtools::StackReader rdr( src, 8, 64 );
+        assert( readAll( rdr ) == text );
+        assert( !src.isCompressed() && !src.hasError() );
+    }
+
+    // Shorter than the magic.
+    const std::string x = "x", none;
+    gtools::GzipSource one( memorySource( x ), false );
+    gtools::StackReader rdr( one );
+    assert( readAll( rdr ) == "x" );
+
+    gtools::GzipSource empty( memorySource( none ), true );
+    gtools::StackReader erdr( empty );
+    assert( !erdr.isReadable() );
+}
+
+void testBroken( const std::string& text, const std::string& compressed ){
+    for( bool threaded : { false, true } ){
+        // Truncated - the data read so far is given, then the error.
+        std::string cut = compressed.substr( 0, compressed.size() / 2 );
+        gtools::GzipSource src( memorySource( cut ), threaded, 1000 );
+        gtools::StackReader rdr( src, 8, 64 );
+        std::string got = readAll( rdr );
+        if(debug) std::cout<<"[ Truncated: "<< got.size() <<" of "<< text.size() <<" bytes ]\n";
+        assert( got.size() < text.size() && got == text.substr( 0, got.size() ) );
+        assert( src.hasError() );
+
+        // Corrupt deflate data.
+        std::string bad = compressed;
+        for( size_t i = 20; i < 40; i++ )
+            bad[i] = (char)0xFF;
+        gtools::GzipSource bsrc( memorySource( bad ), threaded );
+        gtools::StackReader brdr( bsrc );
+        readAll( brdr );
+        assert( bsrc.hasError() );
+    }
+}
+
+void testFile( const std::string& text, const std::string& compressed ){
+    char path[] = "/tmp/gzipsource_test_XXXXXX";
+    int fd = mkstemp( path );
+    assert( fd >= 0 );
+    FILE* file = fdopen( fd, "wb" );
+    std::fwrite( compressed.data(), 1, compressed.size(), file );
+    std::fclose( file );
+
+    gtools::StackReader rdr( std::unique_ptr< gtools::ByteSource >( new gtools::GzipSource( path ) ) );
+    assert( readAll( rdr ) == text );
+    std::remove( path );
+
+    gtools::GzipSource missing( path );
+    assert( !missing.isOpen() && missing.hasError() );
+    char c;
+    assert( missing.read( &c, 1 ) < 0 );
+}
+
+void testEarlyDestruction( const std::string& compressed ){
+    // Helper is waiting for the free blocks - it must be stopped.
+    for( int i = 0; i < 20; i++ ){
+        gtools::GzipSource src( memorySource( compressed ), true, 16, 2 );
+        gtools::StackReader rdr( src, 8, 8 );
+        rdr.getChar();
+    }
+}
+
+int main( int argc, char** argv ){
+    if( argc > 1 ){
+        if( !strcmp( argv[1], "-v") || !strcmp( argv[1], "--debug") ||
+            !strcmp( argv[1], "--verbose") )
+            debug = true;
+    }
+
+    std::cout<<"[ Testing gtools::GzipSource  ] ... ";
+    if(debug) std::cout<<"\n";
+
+    std::string text = makeText( 20000 );
+    std::string compressed = gzip( text );
+    if(debug) std::cout<<"[ "<< text.size() <<" bytes compressed to "<< compressed.size() <<" ]\n";
+
+    testDecompress( text, compressed );
+    testConcatenated( text );
+    testPlain( text );
+    testBroken( text, compressed );
+    testFile( text, compressed );
+    testEarlyDestruction( compressed );
+
+    std::cout<<"[ Passed! ]\n";
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <regex>
+#include <cassert>
+#include <cstring>
+#include <gryltools/lexer.hpp>
+
+static bool debug = false;
+
+enum TokenIds{ KEYWORD, IDENT, NUMBER, FLOAT, ASSIGN, EQUALS, SPACE, STRING, COMMENT };
+
+struct Expected{
+    int32_t id;
+    std::string data;
+    size_t line;
+    size_t column;
+};
+
+void testTokens( const gtools::DfaTables& tables, const std::string& input,
+                 const std::vector< Expected >& expected, size_t bufferSize ){
+    std::istringstream iss( input, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 4, bufferSize );
+    gtools::Lexer lexer( rdr, tables );
+
+    gtools::Token tok;
+    for( const auto& exp : expected ){
+        assert( lexer.getNextToken( tok ) );
+        if( debug )
+            std::cout<<"[ Token "<< tok.id <<" \""<< tok.data.str() <<"\" at "
+                     << tok.line <<":"<< tok.column <<" ]\n";
+        assert( tok.id == exp.id );
+        assert( tok.data == exp.data );
+        assert( tok.line == exp.line && tok.column == exp.column );
+    }
+    assert( !lexer.getNextToken( tok ) );
+}
+
+void testLexer(){
+    gtools::DfaBuilder builder;
+    assert( builder.addRule( KEYWORD, "if|else|while" ) );
+    assert( builder.addRule( IDENT, "[[:alpha:]_][[:alnum:]_]*" ) );
+    assert( builder.addRule( NUMBER, "\\d+" ) );
+    assert( builder.addRule( FLOAT, "\\d+\\.\\d*([eE][-+]?\\d{1,3})?" ) );
+    assert( builder.addRule( ASSIGN, "=" ) );
+    assert( builder.addRule( EQUALS, "==" ) );
+    assert( builder.addRule( SPACE, "\\s+" ) );
+    assert( builder.addRule( STRING, "\"([^\"\\\\\\n]|\\\\.)*\"" ) );
+    assert( builder.addRule( COMMENT, "/\\*([^*]|\\*+[^*/])*\\*+/" ) );
+    assert( builder.build() );
+
+    const std::string input = "if iffy == 12.5e+10=3 \"a\\\"b\"\n"
+                              "  /* long\n comment **/ while#x_1";
+    std::vector< Expected > expected = {
+        { KEYWORD, "if", 0, 0 }, { SPACE, " ", 0, 2 }, { IDENT, "iffy", 0, 3 },
+        { SPACE, " ", 0, 7 }, { EQUALS, "==", 0, 8 }, { SPACE, " ", 0, 10 },
+        { FLOAT, "12.5e+10", 0, 11 }, { ASSIGN, "=", 0, 19 }, { NUMBER, "3", 0, 20 },
+        { SPACE, " ", 0, 21 }, { STRING, "\"a\\\"b\"", 0, 22 }, { SPACE, "\n  ", 0, 28 },
+        { COMMENT, "/* long\n comment **/", 1, 2 }, { SPACE, " ", 2, 12 },
+        { KEYWORD, "while", 2, 13 }, { gtools::Token::UNKNOWN, "#", 2, 18 },
+        { IDENT, "x_1", 2, 19 }
+    };
+
+    // Tokens longer than the buffer must be taken across the refills.
+    testTokens( builder.getTables(), input, expected, 256 );
+    testTokens( builder.getTables(), input, expected, 3 );
+    testTokens( builder.getTables(), input, expected, 1 );
+
+    // Longest match backs off to the last accepting position - "12." is
+    // a float, and the "e" after it is left for the identifier.
+    testTokens( builder.getTables(), "12.e", { { FLOAT, "12.", 0, 0 }, { IDENT, "e", 0, 3 } }, 2 );
+}
+
+void testMinimization(){
+    // Classic example - minimal DFA has 4 states, plus the dead state.
+    gtools::DfaBuilder builder;
+    assert( builder.addRule( 0, "(a|b)*abb" ) );
+    assert( builder.build() );
+    assert( builder.getStateCount() == 5 );
+    assert( builder.getClassCount() == 3 );
+
+    gtools::DfaBuilder counted;
+    assert( counted.addRule( 0, "a{2,4}" ) );
+    assert( counted.addRule( 1, "x{3,}" ) );
+    assert( counted.addRule( 2, "(ab){0}c" ) );
+    assert( counted.build() );
+    testTokens( counted.getTables(), "aaaaaaxxxxxc", { { 0, "aaaa", 0, 0 }, { 0, "aa", 0, 4 },
+                { 1, "xxxxx", 0, 6 }, { 2, "c", 0, 11 } }, 4 );
+}
+
+void testErrors(){
+    gtools::DfaBuilder builder;
+    const char* bad[] = { "(a", "a)", "[a-", "*a", "a{3,2}", "\\b", "[[:nope:]]", "\\q" };
+    for( const char* re : bad ){
+        assert( !builder.addRule( 0, re ) );
+        if( debug )
+            std::cout<<"[ "<< builder.getLastError() <<" ]\n";
+    }
+    assert( !builder.addRule( -2, "a" ) );
+}
+
+// Same tokens as the std::regex alternation in the regexSearcherBench.
+void testAgainstStdRegex(){
+    std::string str;
+    for( int i = 0; i < 50; i++ )
+        str += "foo bar 123[]  \nqvf " + std::to_string( i * 7919 ) + ";";
+
+    gtools::DfaBuilder builder;
+    assert( builder.addRule( 0, "[[:alpha:]]+" ) );
+    assert( builder.addRule( 1, "\\d+" ) );
+    assert( builder.addRule( 2, "\\s+" ) );
+    assert( builder.addRule( 3, "." ) );
+    assert( builder.build() );
+
+    std::regex r( R"(([[:alpha:]]+)|(\d+)|(\s+)|(.))" );
+    std::istringstream iss( str, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 8, 16 );
+    gtools::Lexer lexer( rdr, builder.getTables() );
+    gtools::Token tok;
+
+    const char* beg = str.c_str();
+    const char* end = beg + str.size();
+    std::cmatch m;
+    while( std::regex_search( beg, end, m, r ) ){
+        size_t group = 1;
+        while( !m[ group ].matched )
+            group++;
+
+        assert( lexer.getNextToken( tok ) );
+        assert( tok.id == (int32_t)group - 1 && tok.data == m.str() );
+        beg += m.position() + m.length();
+    }
+    assert( !lexer.getNextToken( tok ) );
+}
+
+int main( int argc, char** argv ){
+    if( argc > 1 ){
+        if( !strcmp( argv[1], "-v") || !strcmp( argv[1], "--debug") ||
+            !strcmp( argv[1], "--verbose") )
+            debug = true;
+    }
+
+    std::cout<<"[ Testing gtools::Lexer       ] ... ";
+    if(debug) std::cout<<"\n";
+
+    testLexer();
+    testMinimization();
+    testErrors();
+    testAgainstStdRegex();
+
+    std::cout<<"[ Passed! ]\n";
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <gryltools/lineindex.hpp>
+
+static bool debug = false;
+
+// Lines of varying lengths, some long enough for multi-byte deltas.
+std::string makeLines( size_t count, std::vector< std::string >& lines ){
+    std::string text;
+    for( size_t i = 0; i < count; i++ ){
+        std::string line = "line " + std::to_string( i ) + " " +
+                           std::string( (i * 37) % 300, 'a' + (char)(i % 26) );
+        lines.push_back( line );
+        text += line + "\n";
+    }
+    return text;
+}
+
+void testLine( const gtools::LineIndex& index, int fd, uint64_t line,
+               const std::vector< std::string >& lines ){
+    std::unique_ptr< gtools::StackReader > rdr;
+    assert( index.openLine( fd, line, rdr ) );
+
+    std::string got;
+    char c;
+    while( rdr->getChar( c ) && c != '\n' )
+        got += c;
+
+    if( debug && got != lines[ line ] )
+        std::cout<<"[ Line "<< line <<" mismatch: \""<< got <<"\" ]\n";
+    assert( got == lines[ line ] );
+}
+
+void testIndex( const gtools::LineIndex& index, FILE* file,
+                const std::vector< std::string >& lines ){
+    assert( index.getLineCount() == lines.size() );
+
+    for( uint64_t i = 0; i < lines.size(); i += 7 )
+        testLine( index, fileno( file ), i, lines );
+    testLine( index, fileno( file ), lines.size() - 1, lines );
+
+    std::unique_ptr< gtools::StackReader > rdr;
+    assert( !index.openLine( fileno( file ), lines.size(), rdr ) );
+}
+
+int main( int argc, char** argv ){
+    if( argc > 1 ){
+        if( !strcmp( argv[1], "-v") || !strcmp( argv[1], "--debug") ||
+            !strcmp( argv[1], "--verbose") )
+            debug = true;
+    }
+
+    std::cout<<"[ Testing gtools::LineIndex   ] ... ";
+    if(debug) std::cout<<"\n";
+
+    std::vector< std::string > lines;
+    std::string text = makeLines( 5000, lines );
+
+    FILE* file = std::tmpfile();
+    assert( file );
+    std::fputs( text.c_str(), file );
+    std::fflush( file );
+
+    // Building from the stream and from the mapped file must give the same.
+    gtools::LineIndex index( 16 );
+    std::istringstream iss( text, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 8, 64 );
+    assert( index.build( rdr ) );
+    assert( index.getFileSize() == text.size() );
+    testIndex( index, file, lines );
+
+    // Descriptor is read from it's offset, and the writes left it at the end.
+    gtools::LineIndex mappedIndex( 16 );
+    std::rewind( file );
+    gtools::StackReader mrdr( fileno( file ) );
+    assert( mappedIndex.build( mrdr ) );
+    assert( mappedIndex.getEncodedSize() == index.getEncodedSize() );
+    testIndex( mappedIndex, file, lines );
+
+    if(debug)
+        std::cout<<"[ Indexed "<< index.getLineCount() <<" lines of "<< text.size()
+                 <<" bytes to "<< index.getEncodedSize() <<" bytes ]\n";
+
+    // Sidecar round trip.
+    FILE* sidecar = std::tmpfile();
+    assert( sidecar );
+    assert( index.save( sidecar ) );
+    std::rewind( sidecar );
+
+    gtools::LineIndex loaded;
+    assert( loaded.load( sidecar ) );
+    assert( loaded.getStep() == 16 );
+    testIndex( loaded, file, lines );
+
+    // Corrupt sizes - encoded size past the file's end, and trailing bytes.
+    std::rewind( sidecar );
+    std::string saved;
+    for( int c; (c = std::fgetc( sidecar )) != EOF; )
+        saved += (char)c;
+    uint64_t encodedSize = 0;
+    for( int i = 0; i < 8; i++ )
+        encodedSize |= (uint64_t)(unsigned char)saved[ 37 + i ] << ( 8 * i );
+
+    for( uint64_t badSize : { ~(uint64_t)0, encodedSize + 1 } ){
+        std::string bad = saved;
+        for( int i = 0; i < 8; i++ )
+            bad[ 37 + i ] = (char)( badSize >> ( 8 * i ) );
+        if( badSize == encodedSize + 1 )
+            bad += '\x01';
+
+        FILE* badSidecar = std::tmpfile();
+        assert( badSidecar );
+        std::fwrite( bad.data(), 1, bad.size(), badSidecar );
+        std::rewind( badSidecar );
+        assert( !loaded.load( badSidecar ) );
+        assert( loaded.getLineCount() == 0 );
+        std::fclose( badSidecar );
+    }
+
+    // Garbage is not an index.
+    std::rewind( sidecar );
+    std::fputs( "not an index", sidecar );
+    std::rewind( sidecar );
+    assert( !loaded.load( sidecar ) );
+    assert( loaded.getLineCount() == 0 );
+    std::fclose( sidecar );
+
+    // Changed file must not be accessed through the stale index.
+    std::fputs( "more\n", file );
+    std::fflush( file );
+    std::unique_ptr< gtools::StackReader > stale;
+    assert( !index.openLine( fileno( file ), 0, stale ) );
+    std::fclose( file );
+
+    // Last line without a newline still counts.
+    gtools::LineIndex small( 2 );
+    std::istringstream siss( "a\nb\nc", std::ios::in | std::ios::binary );
+    gtools::StackReader srdr( siss );
+    assert( small.build( srdr ) );
+    assert( small.getLineCount() == 3 );
+
+    std::cout<<"[ Passed! ]\n";
+
+    return 0;
+}
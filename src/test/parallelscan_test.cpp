@@ -0,0 +1,119 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <gryltools/parallelscan.hpp>
+
+static bool debug = false;
+
+// Per-chunk result: lines containing the searched word, by local line number.
+struct WordHits{
+    std::vector< size_t > lines;
+};
+
+// Counts the chunk's newlines, and records lines containing "needle".
+void findNeedles( gtools::StackReader& rdr, gtools::ScanChunk& chunk, WordHits& hits ){
+    std::string line;
+    char c;
+    while( rdr.getChar( c ) ){
+        if( c == '\n' ){
+            if( line.find( "needle" ) != std::string::npos )
+                hits.lines.push_back( chunk.endlines );
+            chunk.endlines++;
+            line.clear();
+        }
+        else
+            line += c;
+    }
+    if( line.find( "needle" ) != std::string::npos )
+        hits.lines.push_back( chunk.endlines );
+}
+
+void testScan( FILE* file, const std::vector< size_t >& expected, size_t totalLines,
+               size_t threads, size_t chunkCount ){
+    std::vector< gtools::ScanChunk > chunks;
+    std::vector< WordHits > results;
+
+    assert( gtools::ParallelScan::scan< WordHits >( fileno( file ), findNeedles,
+                                                    chunks, results, threads, chunkCount ) );
+    assert( chunks.size() == results.size() );
+    assert( chunks.size() <= chunkCount );
+
+    // Chunks must cover the file contiguously, starting at line starts.
+    uint64_t offset = 0;
+    std::vector< size_t > found;
+    for( size_t i = 0; i < chunks.size(); i++ ){
+        assert( chunks[i].index == i && chunks[i].offset == offset );
+        offset += chunks[i].length;
+
+        for( size_t local : results[i].lines )
+            found.push_back( chunks[i].firstLine + local );
+    }
+
+    const auto& last = chunks.back();
+    assert( last.firstLine + last.endlines == totalLines );
+
+    if(debug)
+        std::cout<<"[ "<< threads <<" threads, "<< chunks.size() <<" chunks, found "
+                 << found.size() <<" needles ]\n";
+    assert( found == expected );
+}
+
+int main( int argc, char** argv ){
+    if( argc > 1 ){
+        if( !strcmp( argv[1], "-v") || !strcmp( argv[1], "--debug") ||
+            !strcmp( argv[1], "--verbose") )
+            debug = true;
+    }
+
+    std::cout<<"[ Testing gtools::ParallelScan] ... ";
+    if(debug) std::cout<<"\n";
+
+    std::string text;
+    std::vector< size_t > expected;
+    const size_t lineCount = 20000;
+    for( size_t i = 0; i < lineCount; i++ ){
+        text += "line " + std::to_string( i ) + std::string( i % 97, '.' );
+        if( i % 113 == 0 ){
+            text += " needle";
+            expected.push_back( i );
+        }
+        text += "\n";
+    }
+
+    FILE* file = std::tmpfile();
+    assert( file );
+    std::fputs( text.c_str(), file );
+    std::fflush( file );
+
+    testScan( file, expected, lineCount, 1, 1 );
+    testScan( file, expected, lineCount, 4, 4 );
+    testScan( file, expected, lineCount, 3, 17 );
+    testScan( file, expected, lineCount, 8, 1000 );
+
+    // More chunks than lines - empty ones are dropped.
+    FILE* tiny = std::tmpfile();
+    assert( tiny );
+    std::fputs( "a\nneedle\nb", tiny );
+    std::fflush( tiny );
+    testScan( tiny, std::vector< size_t >{ 1 }, 2, 4, 8 );
+    std::fclose( tiny );
+
+    // Pipe has no size, so there's nothing to split.
+    int fds[2];
+    assert( pipe( fds ) == 0 );
+    std::vector< gtools::ScanChunk > chunks;
+    assert( gtools::ParallelScan::splitFile( fds[0], 4, chunks ) );
+    assert( chunks.empty() );
+    close( fds[0] );
+    close( fds[1] );
+
+    std::fclose( file );
+
+    std::cout<<"[ Passed! ]\n";
+
+    return 0;
+}
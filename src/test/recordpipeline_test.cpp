@@ -0,0 +1,130 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <gryltools/recordpipeline.hpp>
+
+static bool debug = false;
+
+struct Counts{
+    size_t records = 0;
+    uint64_t sum = 0;
+};
+
+std::string makeText( size_t records, bool lastNewline ){
+    std::string text;
+    for( size_t i = 0; i < records; i++ ){
+        text += "record " + std::to_string( i ) + std::string( i % 17, '.' );
+        if( i + 1 < records || lastNewline )
+            text += '\n';
+    }
+    return text;
+}
+
+// Counts and sums the record numbers, checking that the batch is whole records.
+void parseBatch( const gtools::RecordBatch& batch, Counts& counts ){
+    std::istringstream iss( batch.data );
+    std::string line;
+    while( std::getline( iss, line ) ){
+        assert( line.compare( 0, 7, "record " ) == 0 );
+        counts.sum += std::strtoull( line.c_str() + 7, nullptr, 10 );
+        counts.records++;
+    }
+
+    // Workers finish out of order.
+    if( batch.index % 3 == 0 )
+        std::this_thread::yield();
+}
+
+void testOrdered( const std::string& text, size_t records ){
+    for( size_t threads : { (size_t)1, (size_t)3, (size_t)8 } ){
+        for( size_t batchSize : { (size_t)1, (size_t)10, (size_t)4096 } ){
+            std::istringstream iss( text );
+            gtools::StackReader rdr( iss, 8, 64 );
+
+            std::string merged;
+            size_t nextIndex = 0, total = 0;
+            size_t batches = gtools::RecordPipeline::run< Counts >( rdr, parseBatch,
+                [&]( const gtools::RecordBatch& batch, Counts& counts ){
+                    assert( batch.index == nextIndex++ );
+                    merged += batch.data;
+                    total += counts.records;
+                }, true, threads, batchSize );
+
+            if(debug) std::cout<<"[ "<< threads <<" threads, batch "<< batchSize <<": "
+                               << batches <<" batches ]\n";
+            assert( batches == nextIndex );
+            assert( merged == text && total == records );
+        }
+    }
+}
+
+void testUnordered( const std::string& text, size_t records ){
+    std::istringstream iss( text );
+    gtools::StackReader rdr( iss, 8, 64 );
+
+    std::vector< bool > seen;
+    Counts total;
+    size_t batches = gtools::RecordPipeline::run< Counts >( rdr, parseBatch,
+        [&]( const gtools::RecordBatch& batch, Counts& counts ){
+            if( seen.size() <= batch.index )
+                seen.resize( batch.index + 1 );
+            assert( !seen[ batch.index ] );
+            seen[ batch.index ] = true;
+            total.records += counts.records;
+            total.sum += counts.sum;
+        }, false, 4, 100 );
+
+    assert( batches == seen.size() );
+    assert( total.records == records && total.sum == (uint64_t)records * ( records - 1 ) / 2 );
+}
+
+void testNoMerge( const std::string& text, size_t records ){
+    std::istringstream iss( text );
+    gtools::StackReader rdr( iss );
+
+    std::atomic< size_t > parsed( 0 );
+    gtools::RecordPipeline::run< Counts >( rdr,
+        [&]( const gtools::RecordBatch& batch, Counts& counts ){
+            parseBatch( batch, counts );
+            parsed += counts.records;
+        }, nullptr, true, 3, 500 );
+    assert( parsed == records );
+}
+
+void testEmpty(){
+    std::istringstream iss( "" );
+    gtools::StackReader rdr( iss );
+    size_t batches = gtools::RecordPipeline::run< Counts >( rdr, parseBatch,
+        []( const gtools::RecordBatch&, Counts& ){ assert( false ); } );
+    assert( batches == 0 );
+}
+
+int main( int argc, char** argv ){
+    if( argc > 1 ){
+        if( !strcmp( argv[1], "-v") || !strcmp( argv[1], "--debug") ||
+            !strcmp( argv[1], "--verbose") )
+            debug = true;
+    }
+
+    std::cout<<"[ Testing gtools::RecordPipeline] ... ";
+    if(debug) std::cout<<"\n";
+
+    const size_t records = 3000;
+    for( bool lastNewline : { true, false } ){
+        std::string text = makeText( records, lastNewline );
+        testOrdered( text, records );
+        testUnordered( text, records );
+        testNoMerge( text, records );
+    }
+    testEmpty();
+
+    std::cout<<"[ Passed! ]\n";
+
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cstdio>
+#include <cstdint>
+#include <gryltools/scantools.hpp>
+
+static bool debug = false;
+
+// Reference implementation - plain per-byte loop, as in the old StackReader.
+const char* refSkipWhitespace( const char* p, const char* end, bool stopAtNewline,
+                               size_t& newlines, const char*& lastNewline ){
+    for( ; p < end; p++ ){
+        if( *p == '\n' ){
+            if( stopAtNewline )
+                return p;
+            ++newlines;
+            lastNewline = p;
+        }
+        else if( !std::isspace( *p ) )
+            return p;
+    }
+    return p;
+}
+
+void testSkipWhitespace( const std::string& buf, bool stopAtNewline ){
+    // Test every start offset, so that all vector alignments and tails are hit.
+    for( size_t i = 0; i < buf.size(); i++ ){
+        const char* beg = buf.c_str() + i;
+        const char* end = buf.c_str() + buf.size();
+        size_t n1 = 0, n2 = 0;
+        const char* l1 = nullptr, *l2 = nullptr;
+
+        const char* r1 = gtools::ScanTools::skipWhitespace( beg, end, stopAtNewline, n1, l1 );
+        const char* r2 = refSkipWhitespace( beg, end, stopAtNewline, n2, l2 );
+
+        if( debug && (r1 != r2 || n1 != n2 || l1 != l2) )
+            std::cout<<"[ SkipWhitespace mismatch at offset "<< i <<": "<< (r1 - beg) 
+                     <<" != "<< (r2 - beg) <<", lines "<< n1 <<" != "<< n2 <<" ]\n";
+        assert( r1 == r2 );
+        assert( n1 == n2 );
+        assert( l1 == l2 );
+        assert( gtools::ScanTools::skipWhitespace( beg, end, stopAtNewline ) == r2 );
+    }
+}
+
+void testFindFirstOf( const std::string& buf, const std::string& delims ){
+    gtools::CharSet set( delims );
+    for( size_t i = 0; i < buf.size(); i++ ){
+        const char* beg = buf.c_str() + i;
+        const char* end = buf.c_str() + buf.size();
+
+        size_t pos = buf.find_first_of( delims, i );
+        const char* ref = ( pos == std::string::npos ? end : buf.c_str() + pos );
+
+        assert( gtools::ScanTools::findFirstOf( beg, end, set ) == ref );
+    }
+}
+
+void testCountNewlines( const std::string& buf ){
+    for( size_t i = 0; i < buf.size(); i++ ){
+        const char* beg = buf.c_str() + i;
+        const char* end = buf.c_str() + buf.size();
+        size_t n1 = 0, n2 = 0;
+        const char* l1 = nullptr, *l2 = nullptr;
+
+        for( const char* p = beg; p < end; p++ ){
+            if( *p == '\n' ){
+                n2++;
+                l2 = p;
+            }
+        }
+        n1 = gtools::ScanTools::countNewlines( beg, end, l1 );
+
+        assert( n1 == n2 );
+        assert( l1 == l2 );
+    }
+}
+
+void testParseInt(){
+    using namespace gtools::ScanTools;
+    const char* s;
+    int64_t i = 7;
+    uint64_t u = 7;
+
+    s = "-9223372036854775808,";
+    assert( parseInt64( s, s + std::strlen( s ), i ) == s + 20 && i == INT64_MIN );
+    s = "+9223372036854775807";
+    assert( parseInt64( s, s + std::strlen( s ), i ) == s + 20 && i == INT64_MAX );
+    s = "18446744073709551615";
+    assert( parseUInt64( s, s + std::strlen( s ), u ) == s + 20 && u == UINT64_MAX );
+    s = "000000000000000000000042x";
+    assert( parseUInt64( s, s + std::strlen( s ), u ) == s + 24 && u == 42 );
+
+    // Overflow, no digits, and sign on unsigned fail, leaving the value.
+    i = u = 7;
+    s = "9223372036854775808";
+    assert( parseInt64( s, s + std::strlen( s ), i ) == s && i == 7 );
+    s = "18446744073709551616";
+    assert( parseUInt64( s, s + std::strlen( s ), u ) == s && u == 7 );
+    s = "-x";
+    assert( parseInt64( s, s + std::strlen( s ), i ) == s && i == 7 );
+    s = "-1";
+    assert( parseUInt64( s, s + std::strlen( s ), u ) == s && u == 7 );
+}
+
+void testParseDouble( const std::string& str, size_t expectedLen ){
+    double v = -1;
+    const char* end = gtools::ScanTools::parseDouble( str.c_str(), str.c_str() + str.size(), v );
+    if( debug && (size_t)( end - str.c_str() ) != expectedLen )
+        std::cout<<"[ \""<< str <<"\": parsed "<< ( end - str.c_str() ) <<" ]\n";
+    assert( (size_t)( end - str.c_str() ) == expectedLen );
+
+    if( expectedLen ){
+        double ref = std::strtod( str.substr( 0, expectedLen ).c_str(), nullptr );
+        if( debug && v != ref )
+            std::cout<<"[ \""<< str <<"\": "<< v <<" != "<< ref <<" ]\n";
+        assert( v == ref );
+    }
+}
+
+void testParseDoubles(){
+    testParseDouble( "0", 1 );
+    testParseDouble( "-0.0", 4 );
+    testParseDouble( "3.25", 4 );
+    testParseDouble( "5.", 2 );
+    testParseDouble( ".5e1", 4 );
+    testParseDouble( "1697040000.123456 ", 17 );
+    testParseDouble( "1e22", 4 );
+    testParseDouble( "1e23", 4 );
+    testParseDouble( "1.7976931348623157e308", 22 );
+    testParseDouble( "4.9e-324", 8 );
+    testParseDouble( "0.000000000000000000000000000001", 32 );
+    testParseDouble( "123456789012345678901234567890", 30 );
+    testParseDouble( "9007199254740993", 16 );
+    testParseDouble( "2e", 1 );
+    testParseDouble( "2e+x", 1 );
+    testParseDouble( "-", 0 );
+    testParseDouble( ".e5", 0 );
+    testParseDouble( "1e400", 0 );
+
+    // Random values printed in full precision must round trip.
+    char buf[ 512 ];
+    for( int i = 0; i < 10000; i++ ){
+        uint64_t bits = ( (uint64_t)rand() << 42 ) ^ ( (uint64_t)rand() << 21 ) ^ (uint64_t)rand();
+        double v;
+        std::memcpy( &v, &bits, sizeof( v ) );
+        if( v != v || v - v != 0 )
+            continue;
+        int len = std::snprintf( buf, sizeof( buf ), ( i % 2 ? "%.17g" : "%.6f" ), v );
+        testParseDouble( buf, len );
+
+        len = std::snprintf( buf, sizeof( buf ), "%d.%03d", rand() % 100000, rand() % 1000 );
+        testParseDouble( buf, len );
+    }
+}
+
+std::string generateWhitespaceSample( size_t size, int nonWsChance ){
+    const char ws[] = " \t\n\v\f\r";
+    std::string str;
+    for( size_t i = 0; i < size; i++ ){
+        if( rand() % 100 < nonWsChance )
+            str.push_back( char( 33 + rand() % 200 ) );
+        else
+            str.push_back( ws[ rand() % 6 ] );
+    }
+    return str;
+}
+
+int main( int argc, char** argv ){
+    if( argc > 1 ){
+        if( !strcmp( argv[1], "-v") || !strcmp( argv[1], "--debug") || 
+            !strcmp( argv[1], "--verbose") )
+            debug = true;
+    }
+
+    std::cout<<"[ Testing gtools::ScanTools   ] ... ";
+    if(debug) std::cout<<"\n";
+
+    srand( 1337 );
+    for( int chance : { 0, 1, 3, 10, 50 } ){
+        std::string sample = generateWhitespaceSample( 300, chance );
+        testSkipWhitespace( sample, false );
+        testSkipWhitespace( sample, true );
+    }
+    testSkipWhitespace( std::string( 100, ' ' ) + "\n\n\n" + std::string( 40, '\t' ), false );
+
+    std::string sample = generateWhitespaceSample( 300, 3 );
+    testFindFirstOf( sample, "\xF0" );
+    testFindFirstOf( sample, "\n" );
+    testFindFirstOf( sample, "\n\t" );
+    testFindFirstOf( sample, "\v\f\x80" );
+    testFindFirstOf( sample, "\v\f\x80\r" );
+    testFindFirstOf( sample, "\v\f\x80\r " );
+    testFindFirstOf( sample, "" );
+    testCountNewlines( sample );
+    testParseInt();
+    testParseDoubles();
+
+    std::cout<<"[ Passed! ]\n";
+
+    return 0;
+}
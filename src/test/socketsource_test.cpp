@@ -0,0 +1,138 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <gryltools/socketsource.hpp>
+#include <gryltools/stackreader.hpp>
+
+static bool debug = false;
+
+struct SocketPair{
+    SOCKET ends[2];
+
+    SocketPair(){ assert( socketpair( AF_UNIX, SOCK_STREAM, 0, ends ) == 0 ); }
+    ~SocketPair(){
+        gsockCloseSocket( ends[0] );
+        gsockCloseSocket( ends[1] );
+    }
+
+    void send( const std::string& str ){
+        assert( gsockSend( ends[1], str.data(), str.size(), 0 ) == (int)str.size() );
+    }
+    void close(){
+        shutdown( ends[1], SHUT_WR );
+    }
+};
+
+void testBlocking(){
+    // Lines sent in pieces, cut anywhere.
+    SocketPair sp;
+    std::string text;
+    for( int i = 0; i < 2000; i++ )
+        text += "message " + std::to_string( i ) + " body\n";
+
+    std::thread writer( [&](){
+        for( size_t i = 0; i < text.size(); i += 37 )
+            sp.send( text.substr( i, 37 ) );
+        sp.close();
+    } );
+
+    gtools::SocketSource src( sp.ends[0] );
+    gtools::StackReader rdr( src, 16, 64 );
+    assert( src.isPrefetchable() );
+    std::string line;
+    int count = 0;
+    while( rdr.getStringUntilDelim( line, "\n" ) ){
+        assert( line == "message " + std::to_string( count ) + " body" );
+        assert( rdr.getChar() == '\n' );
+        line.clear();
+        count++;
+    }
+    writer.join();
+
+    assert( count == 2000 );
+    assert( !rdr.wouldBlock() && !rdr.isReadable() );
+}
+
+void testNonBlocking(){
+    SocketPair sp;
+    gtools::SocketSource src( sp.ends[0] );
+    assert( src.setNonBlocking( true ) );
+    gtools::StackReader rdr( src, 16, 64 );
+
+    // Prefetcher would end the stream at the first READ_WOULD_BLOCK.
+    assert( !src.isPrefetchable() && !rdr.startPrefetch() );
+
+    // Nothing sent yet - not the end.
+    assert( !rdr.isReadable() && rdr.wouldBlock() );
+
+    // Line completed by the next piece - appending resumes it.
+    sp.send( "hello wo" );
+    std::string line;
+    assert( rdr.getStringUntilDelim( line, "\n" ) && line == "hello wo" );
+    assert( !rdr.isReadable() && rdr.wouldBlock() );
+
+    sp.send( "rld\nnum 12" );
+    assert( rdr.getStringUntilDelim( line, "\n" ) && line == "hello world" );
+    assert( rdr.getChar() == '\n' );
+
+    // Number cut by the missing data looks complete - the token is parsed
+    // again from the mark once more data arrives.
+    size_t mark = rdr.mark();
+    int64_t value = 0;
+    line.clear();
+    assert( rdr.getStringUntilDelim( line, " " ) && rdr.getChar() == ' ' );
+    assert( rdr.getInt64( value ) && value == 12 );
+    assert( rdr.wouldBlock() );
+    if(debug) std::cout<<"[ Suspended at \""<< line <<" "<< value <<"\" ]\n";
+    assert( rdr.rewind( mark ) );
+
+    sp.send( "34 " );
+    line.clear();
+    assert( rdr.getStringUntilDelim( line, " " ) && rdr.getChar() == ' ' );
+    assert( rdr.getInt64( value ) && value == 1234 );
+    assert( !rdr.wouldBlock() );
+    assert( rdr.getChar() == ' ' );
+
+    // Peer closed - now it's the end.
+    sp.close();
+    assert( !rdr.isReadable() && !rdr.wouldBlock() );
+}
+
+void testNonBlockingPipe(){
+    int fds[2];
+    assert( pipe( fds ) == 0 );
+    fcntl( fds[0], F_SETFL, fcntl( fds[0], F_GETFL ) | O_NONBLOCK );
+
+    gtools::StackReader rdr( std::unique_ptr< gtools::ByteSource >( new gtools::FdSource( fds[0], true ) ) );
+    assert( !rdr.startPrefetch() && !rdr.isPrefetching() );
+    assert( !rdr.isReadable() && rdr.wouldBlock() );
+
+    assert( write( fds[1], "ab", 2 ) == 2 );
+    assert( rdr.getChar() == 'a' && rdr.getChar() == 'b' );
+    assert( !rdr.isReadable() && rdr.wouldBlock() );
+
+    close( fds[1] );
+    assert( !rdr.isReadable() && !rdr.wouldBlock() );
+}
+
+int main( int argc, char** argv ){
+    if( argc > 1 ){
+        if( !strcmp( argv[1], "-v") || !strcmp( argv[1], "--debug") ||
+            !strcmp( argv[1], "--verbose") )
+            debug = true;
+    }
+
+    std::cout<<"[ Testing gtools::SocketSource] ... ";
+    if(debug) std::cout<<"\n";
+
+    testBlocking();
+    testNonBlocking();
+    testNonBlockingPipe();
+
+    std::cout<<"[ Passed! ]\n";
+
+    return 0;
+}
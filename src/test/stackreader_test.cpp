@@ -2,10 +2,35 @@
 #include <sstream>
 #include <cassert>
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <atomic>
+#include <cstdlib>
 #include <gryltools/stackreader.hpp>
+#include <gryltools/staticstackreader.hpp>
+#include <gryltools/lexer.hpp>
 
 static bool debug = false;
 
+// Heap allocations, counted to check the heap-free readers.
+static std::atomic< size_t > allocationCount( 0 );
+
+void* operator new( size_t size ){
+    allocationCount++;
+    if( void* ptr = std::malloc( size ? size : 1 ) )
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete( void* ptr ) noexcept {
+    std::free( ptr );
+}
+
+void operator delete( void* ptr, size_t ) noexcept {
+    std::free( ptr );
+}
+
 
 void testGetCharWithEndPos( gtools::StackReader& rdr, const char* result, 
                             size_t resSize, size_t endPosition ) {
@@ -69,6 +94,22 @@ void testSkipWhitespace(gtools::StackReader& rdr, int skipmode, size_t lns, size
     assert( p == (startPos + pss) );
 }
 
+// Overloads without the counters skip the same, across the refills.
+void testUncountedSkips(){
+    std::istringstream iss( "  \t   a \n\n   b  \n  c  ", std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 4, 4 );
+
+    char c, buf[ 4 ];
+    assert( rdr.getChar( c, gtools::StackReader::SKIPMODE_SKIPWS ) && c == 'a' );
+    assert( rdr.getChar( c, gtools::StackReader::SKIPMODE_SKIPWS_NONEWLINE ) && c == '\n' );
+    assert( rdr.getString( buf, 2, gtools::StackReader::SKIPMODE_SKIPWS ) == 2 );
+    assert( buf[0] == 'b' && buf[1] == ' ' );
+    assert( rdr.skipWhitespace( gtools::StackReader::SKIPMODE_SKIPWS_NONEWLINE ) );
+    assert( rdr.getChar() == '\n' );
+    assert( rdr.skipWhitespace() && rdr.getChar() == 'c' );
+    assert( !rdr.skipWhitespace() );
+}
+
 void testSkipUntil( gtools::StackReader& rdr, size_t lns, size_t pss, 
                     std::function< bool(char) > delimCbk) 
 {
@@ -185,24 +226,7 @@ const char* data =
     "  \n  \t    \t  gryllotronix woop woop\n da ting goes skrrrrra bnjab    \n\n"
     "mbababd najbd \n asfbaf ayge u88 \n6a   aff a1337;";
 
-int main( int argc, char** argv ){
-    if( argc > 1 ){
-        if( !strcmp( argv[1], "-v") || !strcmp( argv[1], "--debug") || 
-            !strcmp( argv[1], "--verbose") )
-            debug = true;
-    }
-
-    std::cout<<"[ Testing gtools::StackReader ] ... ";
-    if(debug) std::cout<<"\n";
-
-    // Testing streams and buffers.
-    std::istringstream iss( data, std::ios::in | std::ios::binary );
-    std::string str(32, ' ');
-    char c = 'a';
-
-    // Create a stack reader with fetch size of 8, and front space of 8.
-    gtools::StackReader rdr( iss, 8, 8 );
-
+void testReaderSequence( gtools::StackReader& rdr ){
     testGetChar(rdr, data, 10);
     testGetChar(rdr, data+10, 20);
 
@@ -248,8 +272,833 @@ int main( int argc, char** argv ){
  
     if(debug) std::cout<<"\nTest end. Stack Front: "<<rdr.getFrontSize()<<
                          ", Stack Back: "<<rdr.getBackSize()<<"\n";
+}
+
+// Compile-time classes and plain lambdas must give the same results as the
+// naive scan over the whole data.
+template< typename Pred >
+void testSkipUntilPredicate( Pred pred, size_t fromOffset ){
+    std::istringstream iss( data + fromOffset, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 8, 8 );
+
+    // Position after the line start is counted from the last '\n', inclusive.
+    const char* start = data + fromOffset;
+    const char* lineStart = start;
+    const char* i = start;
+    size_t lns = 0;
+    for( ; *i; i++ ){
+        if( *i == '\n' ){
+            lns++;
+            lineStart = i;
+        }
+        if( pred( *i ) )
+            break;
+    }
+
+    size_t n = 0, p = 0;
+    assert( rdr.skipUntil( pred, n, p ) );
+    assert( pred( (char)rdr.peekChar() ) );
+
+    if(debug)
+        std::cout<<"[ SkipUntil predicate: NuLines: "<<n<<", PosLines: "<<p<<"]\n"; 
+
+    assert( n == lns );
+    assert( p == (size_t)(i - lineStart) );
+}
+
+void testSkipUntilClasses(){
+    testSkipUntilPredicate( gtools::CharClass<';'>(), 0 );
+    testSkipUntilPredicate( gtools::CharClass<'~', 'z', ';'>(), 3 );
+    testSkipUntilPredicate( gtools::CharRange<'0', '9'>(), 0 );
+    testSkipUntilPredicate( gtools::CharUnion< gtools::CharRange<'0', '9'>, 
+                                               gtools::CharClass<'j'> >(), 20 );
+    testSkipUntilPredicate( gtools::CharClass<'\n'>(), 40 );
+    testSkipUntilPredicate( [](char c){ return c == 'q' || c == 'y'; }, 0 );
+
+    static_assert( gtools::CharClass<'a', 'b'>()( 'b' ), "CharClass must be constexpr" );
+    static_assert( !gtools::CharRange<'a', 'c'>()( 'd' ), "CharRange must be constexpr" );
+}
+
+// Mapped reader must behave the same, and putting back already read
+// bytes must not leave the mapping.
+void testMappedReader(){
+    FILE* tmp = std::tmpfile();
+    assert( tmp );
+    std::fputs( data, tmp );
+    std::fflush( tmp );
+    std::rewind( tmp );
+
+    gtools::StackReader mrdr( fileno( tmp ), 8, 8 );
+    assert( mrdr.isDirect() );
+    testGetChar(mrdr, "kawaii");
+    mrdr.putString("waii");
+    testCurrentLength(mrdr, std::strlen( data ) - 2);
+    mrdr.putString("ka");
+    testCurrentLength(mrdr, std::strlen( data ));
+
+    testReaderSequence( mrdr );
+    std::fclose( tmp );
+}
+
+// Descriptor is read from it's current offset, whether it's mapped or not,
+// and it's advanced past what was read.
+void testDescriptorOffset(){
+    const char* text = "HEADER\nbody\n";
+    FILE* tmp = std::tmpfile();
+    assert( tmp );
+    std::fputs( text, tmp );
+    std::fflush( tmp );
+    assert( lseek( fileno( tmp ), 7, SEEK_SET ) == 7 );
+    {
+        gtools::StackReader rdr( fileno( tmp ), 8, 8 );
+        assert( rdr.isDirect() );
+        testGetCharWithEndPos( rdr, "body\n", 4 );
+        assert( !rdr.isReadable() );
+    }
+    assert( lseek( fileno( tmp ), 0, SEEK_CUR ) == (off_t)std::strlen( text ) );
+    std::fclose( tmp );
+
+    int fds[2];
+    assert( pipe( fds ) == 0 );
+    assert( write( fds[1], text, std::strlen( text ) ) == (ssize_t)std::strlen( text ) );
+    close( fds[1] );
+    char header[ 7 ];
+    assert( read( fds[0], header, 7 ) == 7 );
+    {
+        gtools::StackReader rdr( fds[0], 8, 8 );
+        assert( !rdr.isDirect() );
+        testGetCharWithEndPos( rdr, "body\n", 4 );
+        assert( !rdr.isReadable() );
+    }
+    close( fds[0] );
+}
+
+// Other sources must give the same sequence too.
+void testByteSources(){
+    gtools::MemorySource memSrc( data, std::strlen( data ) );
+    gtools::StackReader memRdr( memSrc, 8, 8 );
+    assert( memRdr.isDirect() );
+    testReaderSequence( memRdr );
+
+    // Callback giving irregular short reads.
+    size_t pos = 0;
+    gtools::StackReader cbRdr( [&pos]( char* buff, size_t len ) -> long {
+        size_t left = std::strlen( data ) - pos;
+        len = std::min( std::min( len, left ), (size_t)3 );
+        std::memcpy( buff, data + pos, len );
+        pos += len;
+        return (long)len;
+    }, 8, 8 );
+    testReaderSequence( cbRdr );
+
+    // Descriptor range, read by pread().
+    FILE* tmp = std::tmpfile();
+    assert( tmp );
+    std::fputs( data, tmp );
+    std::fflush( tmp );
+
+    gtools::FdSource fdSrc( fileno( tmp ), 10, 20 );
+    gtools::StackReader fdRdr( fdSrc, 8, 8 );
+    testGetCharWithEndPos( fdRdr, data + 10, 20, 19 );
+    assert( !fdRdr.isReadable() );
+    std::fclose( tmp );
+}
+
+// Views must keep pointing to the right bytes, while reader refills, and
+// has bytes put back, until they're released.
+void testViewSequence( gtools::StackReader& rdr ){
+    const char* pos = data;
+    gtools::StackReader::View first, second, word;
+
+    // Longer than the whole stack - must be grown.
+    assert( rdr.getView( first, 30 ) );
+    assert( first.equals( data, 30 ) );
+    assert( rdr.activeViews() == 1 );
+    pos += 30;
+
+    assert( rdr.getViewUntilDelim( second, "a" ) );
+    size_t len = std::strchr( pos, 'a' ) - pos;
+    assert( second.equals( pos, len ) );
+    pos += len;
+
+    // Put back, and read more, with the views still alive.
+    char c;
+    assert( rdr.getChar( c ) && c == 'a' );
+    assert( rdr.putChar( 'X' ) );
+    assert( rdr.getChar( c ) && c == 'X' );
+    ++pos;
+
+    assert( rdr.getViewWhile( word, []( char ch ){ return ch != '\n'; } ) );
+    len = std::strchr( pos, '\n' ) - pos;
+    assert( word.equals( pos, len ) );
+    pos += len;
+    testGetChar( rdr, pos, 40 );
+    pos += 40;
+
+    assert( first.equals( data, 30 ) );
+    assert( word.equals( pos - 40 - len, len ) );
+    if(debug)
+        std::cout<<"[ Views ]: \""<< first.str() <<"\", \""<< second.str() 
+                 <<"\", \""<< word.str() <<"\"\n";
+
+    // Moved views keep the lease.
+    gtools::StackReader::View moved( std::move( second ) );
+    assert( second.empty() && rdr.activeViews() == 3 );
+    first.release();
+    moved.release();
+    word.release();
+    assert( rdr.activeViews() == 0 );
+
+    // Reading the rest after all views released.
+    gtools::StackReader::View rest;
+    len = std::strlen( pos );
+    assert( rdr.getView( rest, len + 10 ) );
+    assert( rest.equals( pos, len ) );
+    assert( !rdr.getView( rest, 1 ) );
+    assert( rest.empty() && rdr.activeViews() == 0 );
+}
+
+void testViews(){
+    std::istringstream iss( data, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 8, 8 );
+    testViewSequence( rdr );
+
+    std::istringstream piss( data, std::ios::in | std::ios::binary );
+    gtools::StackReader prdr( piss, 8, 8 );
+    assert( prdr.startPrefetch() );
+    testViewSequence( prdr );
+
+    gtools::MemorySource memSrc( data, std::strlen( data ) );
+    gtools::StackReader memRdr( memSrc, 8, 8 );
+    testViewSequence( memRdr );
+
+    size_t pos = 0;
+    gtools::StackReader cbRdr( [&pos]( char* buff, size_t len ) -> long {
+        size_t left = std::strlen( data ) - pos;
+        len = std::min( std::min( len, left ), (size_t)3 );
+        std::memcpy( buff, data + pos, len );
+        pos += len;
+        return (long)len;
+    }, 8, 8 );
+    testViewSequence( cbRdr );
+}
+
+// Chunks held for the views are reused once released - their count stays
+// bounded by the chunks pinned at once, however many refills there are.
+void testViewHeldChunks(){
+    std::string text;
+    for( size_t i = 0; text.size() < 20000; i++ )
+        text += std::to_string( i ) + ' ';
+
+    std::istringstream iss( text, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 8, 8 );
+    assert( rdr.startPrefetch( 4 ) );
+
+    std::string got;
+    char buff[ 16 ];
+    gtools::StackReader::View view;
+    while( rdr.getView( view, 1 ) ){
+        got.append( view.data(), view.size() );
+
+        // View pins the chunk over the next refill.
+        got.append( buff, rdr.getString( buff, 12 ) );
+        view.release();
+    }
+    if(debug) std::cout<<"[ Prefetch chunks after the pinned refills: "
+                       << rdr.getPrefetchChunkCount() <<" ]\n";
+    assert( got == text );
+    assert( rdr.getPrefetchChunkCount() <= 6 );
+}
+
+// History must be kept across refills, so that the last bytes could be 
+// unread and read again.
+void testUnReadSequence( gtools::StackReader& rdr ){
+    const size_t hist = 13;
+    rdr.setHistorySize( hist );
+    assert( !rdr.unRead( 1 ) );
+
+    size_t len = std::strlen( data );
+    char buff[ 32 ];
+    for( size_t pos = 0; pos < len; ){
+        size_t cnt = rdr.getString( buff, 7 );
+        assert( cnt && std::memcmp( buff, data + pos, cnt ) == 0 );
+        pos += cnt;
+
+        size_t back = std::min( pos, hist );
+        assert( rdr.unRead( back ) );
+        testGetCharWithEndPos( rdr, data + pos - back, back, 0 );
+    }
+    assert( !rdr.isReadable() );
+
+    // Unreading after the end makes reader readable again.
+    assert( rdr.unRead( hist ) );
+    assert( rdr.isReadable() );
+    testGetCharWithEndPos( rdr, data + len - hist, hist, 0 );
+
+    // Putting back other bytes discards the history.
+    assert( rdr.unRead( 1 ) );
+    assert( rdr.putChar( '@' ) );
+    assert( !rdr.unRead( 1 ) );
+    testGetChar( rdr, "@" );
+    assert( rdr.unRead( 1 ) );
+    testGetCharWithEndPos( rdr, "@;", 2, 0 );
+}
+
+void testUnRead(){
+    std::istringstream iss( data, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 8, 8 );
+    testUnReadSequence( rdr );
+
+    std::istringstream piss( data, std::ios::in | std::ios::binary );
+    gtools::StackReader prdr( piss, 8, 8 );
+    assert( prdr.startPrefetch() );
+    testUnReadSequence( prdr );
+
+    gtools::MemorySource memSrc( data, std::strlen( data ) );
+    gtools::StackReader memRdr( memSrc, 8, 8 );
+    testUnReadSequence( memRdr );
+}
+
+// Marked bytes must be kept across refills, and nested marks must rewind
+// to their own positions.
+void testMarkSequence( gtools::StackReader& rdr ){
+    char buff[ 64 ];
+    size_t outer = rdr.mark();
+    testGetChar( rdr, data, 20 );
+
+    size_t inner = rdr.mark();
+    assert( rdr.activeMarks() == 2 );
+    assert( rdr.getString( buff, 40 ) == 40 );
+    assert( std::memcmp( buff, data + 20, 40 ) == 0 );
+
+    assert( rdr.rewind( inner ) );
+    assert( rdr.activeMarks() == 1 );
+    testGetChar( rdr, data + 20, 45 );
+
+    assert( rdr.rewind( outer ) );
+    assert( !rdr.rewind( outer ) );
+    assert( rdr.activeMarks() == 0 );
+    testGetChar( rdr, data, 30 );
+
+    // Committed marks stay at the current position.
+    size_t m = rdr.mark();
+    rdr.mark();
+    testGetChar( rdr, data + 30, 30 );
+    assert( rdr.commit( m ) );
+    assert( rdr.activeMarks() == 0 );
+    testGetChar( rdr, data + 60, 10 );
+
+    // Putting back other bytes invalidates the marks.
+    m = rdr.mark();
+    testGetChar( rdr, data + 70, 5 );
+    rdr.putChar( '#' );
+    testGetChar( rdr, "#" );
+    assert( !rdr.rewind( m ) );
+    assert( rdr.activeMarks() == 0 );
+
+    // Marking to the end.
+    size_t len = std::strlen( data );
+    m = rdr.mark();
+    testGetCharWithEndPos( rdr, data + 75, len - 75, len - 76 );
+    assert( !rdr.isReadable() );
+    assert( rdr.rewind( m ) );
+    assert( rdr.isReadable() );
+    testGetCharWithEndPos( rdr, data + 75, len - 75, len - 76 );
+}
+
+void testMarks(){
+    std::istringstream iss( data, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 8, 8 );
+    testMarkSequence( rdr );
+
+    std::istringstream piss( data, std::ios::in | std::ios::binary );
+    gtools::StackReader prdr( piss, 8, 8 );
+    assert( prdr.startPrefetch() );
+    testMarkSequence( prdr );
+
+    gtools::MemorySource memSrc( data, std::strlen( data ) );
+    gtools::StackReader memRdr( memSrc, 8, 8 );
+    testMarkSequence( memRdr );
+
+    size_t pos = 0;
+    gtools::StackReader cbRdr( [&pos]( char* buff, size_t len ) -> long {
+        size_t left = std::strlen( data ) - pos;
+        len = std::min( std::min( len, left ), (size_t)3 );
+        std::memcpy( buff, data + pos, len );
+        pos += len;
+        return (long)len;
+    }, 8, 8 );
+    testMarkSequence( cbRdr );
+}
+
+// Lines read into the reused string must match the data split by '\n'.
+void testGetStringUntilSequence( gtools::StackReader& rdr ){
+    std::string line, rest( data );
+    size_t lines = 0;
+    while( rdr.getStringUntilDelim( line, "\n" ) ){
+        size_t endl = rest.find( '\n' );
+        assert( line == rest.substr( 0, endl ) );
+        rest.erase( 0, endl == std::string::npos ? rest.size() : endl );
+        lines++;
+
+        if( rdr.getChar() == '\n' )
+            rest.erase( 0, 1 );
+        else
+            assert( !rdr.isReadable() );
+        line.clear();
+    }
+    assert( rest.empty() && lines == 11 );
+    assert( !rdr.getStringUntilDelim( line, "\n" ) && line.empty() );
+}
+
+void testGetStringUntilRegexSequence( gtools::StackReader& rdr ){
+    std::string buf;
+    const char* numbers = std::strstr( data, "u88" ) + 1;
+
+    // Appends to what's in the buffer, and leaves the match unread.
+    buf = "> ";
+    assert( rdr.getStringUntilRegex( buf, "\\d\\d+" ) );
+    assert( buf == "> " + std::string( data, numbers ) );
+    testGetChar( rdr, "88" );
+
+    // Invalid regex consumes nothing.
+    assert( !rdr.getStringUntilRegex( buf, "(a" ) );
+    testGetChar( rdr, " \n6" );
+
+    // Match starting at the current position.
+    buf.clear();
+    assert( rdr.getStringUntilRegex( buf, "a+ " ) );
+    assert( buf.empty() );
+    testGetChar( rdr, "a   " );
+
+    // Prefix of the match is not a match - "a1" is skipped, "a13" is found.
+    assert( rdr.getStringUntilRegex( buf, "a13+" ) );
+    assert( buf == "aff " );
+    testGetChar( rdr, "a13" );
+
+    // No match - all that's left is appended.
+    gtools::DfaBuilder builder;
+    assert( builder.addRule( 0, "z" ) && builder.build() );
+    buf.clear();
+    assert( rdr.getStringUntilMatch( buf, builder.getTables() ) );
+    assert( buf == "37;" );
+    assert( !rdr.getStringUntilMatch( buf, builder.getTables() ) );
+}
+
+void testGetStringUntilRegexLong(){
+    // Earlier start matching later wins over a later one matching first.
+    for( const char* text : { "abcz", "abcy" } ){
+        std::istringstream iss( text );
+        gtools::StackReader rdr( iss, 8, 2 );
+        std::string buf;
+        assert( rdr.getStringUntilRegex( buf, "a.*z|bc" ) );
+        assert( buf == ( text[3] == 'z' ? "" : "a" ) );
+    }
+
+    // Prefix keeps matching for long - each byte is scanned once.
+    const std::string run( 200000, 'a' );
+    std::istringstream iss( run + "cxaabtail" );
+    gtools::StackReader rdr( iss, 8, 64 );
+    std::string buf;
+    assert( rdr.getStringUntilRegex( buf, "a+b" ) );
+    assert( buf == run + "cx" );
+    testGetCharWithEndPos( rdr, "aabtail", 6 );
+
+    // Partial matches ruled out are appended, not kept in the buffer.
+    std::string pairs;
+    for( int i = 0; i < 50000; i++ )
+        pairs += "ab";
+    std::istringstream piss( pairs + "abc" );
+    gtools::StackReader prdr( piss, 8, 64 );
+    buf.clear();
+    assert( prdr.getStringUntilRegex( buf, "abc" ) );
+    assert( buf == pairs && prdr.getFrontSize() < 4096 );
+    testGetCharWithEndPos( prdr, "abc", 2 );
+}
+
+void testGetStringUntil(){
+    std::istringstream iss( data, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 8, 8 );
+    testGetStringUntilSequence( rdr );
+
+    std::istringstream piss( data, std::ios::in | std::ios::binary );
+    gtools::StackReader prdr( piss, 8, 8 );
+    assert( prdr.startPrefetch() );
+    testGetStringUntilRegexSequence( prdr );
+
+    gtools::MemorySource memSrc( data, std::strlen( data ) );
+    gtools::StackReader memRdr( memSrc, 8, 8 );
+    testGetStringUntilSequence( memRdr );
+
+    // Matches split across the 3-byte reads.
+    size_t pos = 0;
+    gtools::StackReader cbRdr( [&pos]( char* buff, size_t len ) -> long {
+        size_t left = std::strlen( data ) - pos;
+        len = std::min( std::min( len, left ), (size_t)3 );
+        std::memcpy( buff, data + pos, len );
+        pos += len;
+        return (long)len;
+    }, 8, 8 );
+    testGetStringUntilRegexSequence( cbRdr );
+
+    gtools::MemorySource memRegexSrc( data, std::strlen( data ) );
+    gtools::StackReader memRegexRdr( memRegexSrc, 8, 8 );
+    testGetStringUntilRegexSequence( memRegexRdr );
+
+    testGetStringUntilRegexLong();
+}
+
+void testIteratorSequence( gtools::StackReader& rdr ){
+    // Algorithms stop on the found byte, leaving it unread.
+    auto it = std::find_if( rdr.begin(), rdr.end(), []( char c ){ return c == '~'; } );
+    assert( it != rdr.end() && *it == '~' );
+    testGetChar( rdr, std::strchr( data, '~' ), 3 );
+
+    const char* rest = std::strchr( data, '~' ) + 3;
+    it = rdr.begin();
+    assert( it != rdr.end() && *it++ == 'i' );
+    assert( it != rdr.end() && *it == '\'' );
+
+    // Put back bytes are iterated too.
+    rdr.putChar( '#' );
+    std::string str;
+    for( char c : rdr )
+        str += c;
+    assert( str == "#" + std::string( rest + 1 ) );
+    assert( rdr.begin() == rdr.end() );
+    assert( std::count( rdr.begin(), rdr.end(), 'a' ) == 0 );
+}
+
+void testIterator(){
+    std::istringstream iss( data, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 8, 8 );
+    testIteratorSequence( rdr );
+
+    std::istringstream piss( data, std::ios::in | std::ios::binary );
+    gtools::StackReader prdr( piss, 8, 8 );
+    assert( prdr.startPrefetch() );
+    testIteratorSequence( prdr );
+
+    gtools::MemorySource memSrc( data, std::strlen( data ) );
+    gtools::StackReader memRdr( memSrc, 8, 8 );
+    testIteratorSequence( memRdr );
+
+    // Newlines counted by the STL, across the refills.
+    std::istringstream ciss( data, std::ios::in | std::ios::binary );
+    gtools::StackReader crdr( ciss, 8, 8 );
+    assert( std::count( crdr.begin(), crdr.end(), '\n' ) == 
+            std::count( data, data + std::strlen( data ), '\n' ) );
+}
+
+// Expansion-like putbacks - large strings pushed in front of the buffered
+// data, interleaved with reads and views spanning the pushed segments.
+void testPutbackSegmentsSequence( gtools::StackReader& rdr ){
+    std::string expect( data );
+    gtools::StackReader::View view;
+
+    for( size_t i = 0; i < 200; i++ ){
+        for( size_t k = 0; k < i % 7 && !expect.empty(); k++ ){
+            assert( rdr.getChar() == expect[0] );
+            expect.erase( 0, 1 );
+        }
+
+        std::string pushed( 20 + ( i * 37 ) % 300, (char)( 'A' + i % 26 ) );
+        pushed += std::to_string( i );
+        assert( rdr.putString( pushed ) );
+        expect = pushed + expect;
+
+        if( i % 3 == 0 ){
+            assert( rdr.putChar( '#' ) );
+            expect = "#" + expect;
+        }
+
+        // View stays alive over the next pushes, pinning its segment.
+        if( i % 5 == 0 ){
+            assert( rdr.getView( view, 150 ) );
+            assert( view == expect.substr( 0, 150 ) );
+            expect.erase( 0, 150 );
+        }
+    }
+    view.release();
+
+    std::string rest;
+    for( char c : rdr )
+        rest += c;
+    assert( rest == expect );
+}
+
+void testPutbackSegments(){
+    std::istringstream iss( data, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 8, 8 );
+    testPutbackSegmentsSequence( rdr );
+
+    std::istringstream piss( data, std::ios::in | std::ios::binary );
+    gtools::StackReader prdr( piss, 8, 8 );
+    assert( prdr.startPrefetch() );
+    testPutbackSegmentsSequence( prdr );
+
+    gtools::MemorySource memSrc( data, std::strlen( data ) );
+    gtools::StackReader memRdr( memSrc, 8, 8 );
+    testPutbackSegmentsSequence( memRdr );
+
+    gtools::StaticStackReader< 8, 8 > staticRdr( data, std::strlen( data ) );
+    testPutbackSegmentsSequence( staticRdr );
+}
+
+void testNumbersSequence( gtools::StackReader& rdr ){
+    int64_t i;
+    uint64_t u;
+    double d;
+
+    // Numbers are cut by the small windows.
+    assert( rdr.getInt64( i, gtools::StackReader::SKIPMODE_SKIPWS ) && i == -1234567890123LL );
+    assert( rdr.getUInt64( u, gtools::StackReader::SKIPMODE_SKIPWS ) && u == 18446744073709551615ULL );
+    assert( rdr.getDouble( d, gtools::StackReader::SKIPMODE_SKIPWS ) && d == 3.25e-2 );
+    assert( rdr.getDouble( d, gtools::StackReader::SKIPMODE_SKIPWS ) && d == -1697040000.123456 );
+
+    // Not a number - nothing is consumed.
+    assert( !rdr.getInt64( i, gtools::StackReader::SKIPMODE_SKIPWS ) );
+    assert( rdr.getChar() == 'x' );
+
+    // Overflow leaves the digits unread.
+    assert( !rdr.getInt64( i, gtools::StackReader::SKIPMODE_SKIPWS ) );
+    assert( rdr.getUInt64( u ) && u == 9223372036854775808ULL );
+
+    // Exponent without digits is not a part of the number.
+    assert( rdr.getDouble( d, gtools::StackReader::SKIPMODE_SKIPWS ) && d == 12 );
+    assert( rdr.getChar() == 'e' );
+
+    // Number at the end of the input.
+    assert( rdr.getDouble( d, gtools::StackReader::SKIPMODE_SKIPWS ) && d == 0.5 );
+    assert( !rdr.getDouble( d, gtools::StackReader::SKIPMODE_SKIPWS ) );
+}
+
+void testNumbers(){
+    const char* numbers = "-1234567890123 18446744073709551615\n 3.25e-2\t-1697040000.123456 x"
+                          " 9223372036854775808 12e .5";
+
+    std::istringstream iss( numbers, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 4, 5 );
+    testNumbersSequence( rdr );
+
+    gtools::MemorySource memSrc( numbers, std::strlen( numbers ) );
+    gtools::StackReader memRdr( memSrc, 4, 5 );
+    testNumbersSequence( memRdr );
+
+    gtools::StaticStackReader< 4, 3 > staticRdr( numbers, std::strlen( numbers ) );
+    testNumbersSequence( staticRdr );
+}
+
+void checkPosition( gtools::StackReader& rdr, size_t offset ){
+    size_t line = 0, column = 0;
+    for( size_t i = 0; i < offset; i++ ){
+        if( data[i] == '\n' ){
+            line++;
+            column = 0;
+        }
+        else
+            column++;
+    }
+
+    gtools::StackReader::Position pos = rdr.position();
+    if( debug && ( pos.line != line || pos.column != column ) )
+        std::cout<<"[ Offset "<< offset <<": "<< pos.line <<":"<< pos.column 
+                 <<", expected "<< line <<":"<< column <<" ]\n";
+    assert( pos.line == line && pos.column == column );
+}
+
+void testPositionSequence( gtools::StackReader& rdr ){
+    rdr.setHistorySize( 16 );
+    rdr.setPositionTracking( true );
+    size_t offset = 0;
+    checkPosition( rdr, offset );
+
+    char c;
+    for( ; offset < 5; offset++ )
+        assert( rdr.getChar( c ) );
+    checkPosition( rdr, offset );
+
+    // Scanning past several windows and newlines.
+    assert( rdr.skipUntilChar( 'g' ) );
+    offset = std::strchr( data, 'g' ) - data;
+    checkPosition( rdr, offset );
+
+    gtools::StackReader::View view;
+    assert( rdr.getView( view, 30 ) );
+    offset += 30;
+    checkPosition( rdr, offset );
+
+    // Unread over a newline.
+    view.release();
+    assert( rdr.unRead( 12 ) );
+    offset -= 12;
+    checkPosition( rdr, offset );
+
+    // Rewinding to the mark.
+    size_t m = rdr.mark();
+    std::string line;
+    assert( rdr.getStringUntilDelim( line, "\n" ) );
+    assert( rdr.getStringUntilDelim( line, ";" ) );
+    checkPosition( rdr, offset + line.size() );
+    assert( rdr.rewind( m ) );
+    checkPosition( rdr, offset );
+
+    // Putting back the bytes just read, within a line.
+    for( size_t i = 0; i < 4; i++ )
+        assert( rdr.getChar( c ) );
+    assert( rdr.putString( data + offset, 4 ) );
+    checkPosition( rdr, offset );
+
+    for( char ch : rdr ){
+        (void)ch;
+        offset++;
+    }
+    assert( offset == std::strlen( data ) );
+    checkPosition( rdr, offset );
+}
+
+void testPositionTracking(){
+    std::istringstream iss( data, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 8, 8 );
+    testPositionSequence( rdr );
+
+    std::istringstream piss( data, std::ios::in | std::ios::binary );
+    gtools::StackReader prdr( piss, 8, 8 );
+    assert( prdr.startPrefetch() );
+    testPositionSequence( prdr );
+
+    gtools::MemorySource memSrc( data, std::strlen( data ) );
+    gtools::StackReader memRdr( memSrc, 8, 8 );
+    testPositionSequence( memRdr );
+
+    gtools::StaticStackReader< 8, 8 > staticRdr( data, std::strlen( data ) );
+    testPositionSequence( staticRdr );
+
+    // Not tracking - position stays at the start.
+    gtools::MemorySource untrackedSrc( data, std::strlen( data ) );
+    gtools::StackReader untracked( untrackedSrc );
+    assert( untracked.skipUntilChar( ';' ) );
+    assert( !untracked.isTrackingPosition() );
+    assert( untracked.position().line == 0 && untracked.position().column == 0 );
+}
+
+void testStaticReader(){
+    // Same sequences as the dynamic readers, sharing the code.
+    std::istringstream iss( data, std::ios::in | std::ios::binary );
+    gtools::IStreamSource isrc( iss );
+    gtools::StaticStackReader< 8, 8 > rdr( isrc );
+    testReaderSequence( rdr );
+
+    std::istringstream viss( data, std::ios::in | std::ios::binary );
+    gtools::IStreamSource visrc( viss );
+    gtools::StaticStackReader< 8, 8 > vrdr( visrc );
+    testViewSequence( vrdr );
+
+    gtools::StaticStackReader< 8, 8 > mrdr( data, std::strlen( data ) );
+    testMarkSequence( mrdr );
+
+    // Small messages are read without touching the heap.
+    const char* message = "GET /index.html HTTP/1.1";
+    size_t allocations = allocationCount;
+    for( int i = 0; i < 100; i++ ){
+        gtools::StaticStackReader<> msg( message, std::strlen( message ) );
+        assert( msg.skipUntilChar( ' ' ) && msg.getChar() == ' ' );
+        assert( msg.peekChar() == '/' );
+        assert( msg.putChar( '#' ) && msg.getChar() == '#' );
+    }
+    assert( allocationCount == allocations );
+
+    gtools::MemorySource src( message, std::strlen( message ) );
+    gtools::StaticStackReader< 4, 16 > copied( src );
+    std::string word;
+    assert( copied.getStringUntilDelim( word, " " ) && word == "GET" );
+    assert( allocationCount == allocations );
+}
+
+void testStats(){
+    std::string text;
+    for( int i = 0; i < 1000; i++ )
+        text += "word" + std::to_string( i ) + " ";
+
+    std::istringstream iss( text, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 4, 64 );
+    std::string word;
+    for( int i = 0; i < 10; i++ ){
+        word.clear();
+        assert( rdr.getStringUntilDelim( word, " " ) && rdr.getChar() == ' ' );
+    }
+    size_t consumed = text.find( "word10 " );
+
+    // Putback larger than the whole stack.
+    const std::string back( 100, '#' );
+    assert( rdr.putString( back ) );
+    gtools::StackReader::Stats stats = rdr.getStats();
+    if(debug) std::cout<<"[ Stats: consumed "<< stats.bytesConsumed <<", read "<< stats.bytesRead 
+                       <<", refills "<< stats.refills <<", reallocations "<< stats.reallocations 
+                       <<", moved "<< stats.movedBytes <<", blocked "<< stats.blockedNanos <<" ns ]\n";
+
+    if( !gtools::StackReader::statsEnabled() ){
+        assert( stats.bytesConsumed == 0 && stats.bytesRead == 0 && stats.refills == 0 );
+        return;
+    }
+    assert( stats.bytesConsumed == consumed );
+    assert( stats.bytesRead >= consumed && stats.refills >= consumed / 64 );
+    assert( stats.putbackBytes == back.size() && stats.reallocations >= 1 );
+
+    // Bytes put back count again once read.
+    char buf[ 100 ];
+    assert( rdr.getString( buf, back.size() ) == back.size() );
+    assert( rdr.getStats().bytesConsumed == consumed + back.size() );
+
+    while( rdr.getChar() >= 0 );
+    stats = rdr.getStats();
+    assert( stats.bytesRead == text.size() && stats.bytesConsumed == text.size() + back.size() );
+
+    rdr.resetStats();
+    assert( rdr.getStats().bytesConsumed == 0 && rdr.getStats().refills == 0 );
+}
+
+int main( int argc, char** argv ){
+    if( argc > 1 ){
+        if( !strcmp( argv[1], "-v") || !strcmp( argv[1], "--debug") || 
+            !strcmp( argv[1], "--verbose") )
+            debug = true;
+    }
+
+    std::cout<<"[ Testing gtools::StackReader ] ... ";
+    if(debug) std::cout<<"\n";
+
+    // Testing streams and buffers.
+    std::istringstream iss( data, std::ios::in | std::ios::binary );
+
+    // Create a stack reader with fetch size of 8, and front space of 8.
+    gtools::StackReader rdr( iss, 8, 8 );
+    testReaderSequence( rdr );
+
+    // Same with the stream read ahead by the background thread.
+    std::istringstream piss( data, std::ios::in | std::ios::binary );
+    gtools::StackReader prdr( piss, 8, 8 );
+    assert( prdr.startPrefetch() );
+    testReaderSequence( prdr );
+
+    testSkipUntilClasses();
+    testUncountedSkips();
+    testMappedReader();
+    testDescriptorOffset();
+    testByteSources();
+    testViews();
+    testViewHeldChunks();
+    testUnRead();
+    testMarks();
+    testGetStringUntil();
+    testIterator();
+    testStaticReader();
+    testPutbackSegments();
+    testNumbers();
+    testPositionTracking();
+    testStats();
+
     std::cout<<"[ Passed! ]\n";
 
     return 0;
 }
-
@@ -0,0 +1,258 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <cstring>
+#include <gryltools/utf8reader.hpp>
+#include <gryltools/scantools.hpp>
+
+static bool debug = false;
+
+// Mixed text - ASCII runs long enough for the vector paths, 2, 3 and 4-byte
+// sequences, and Unicode spaces (U+00A0, U+2003, U+3000).
+const std::string sample =
+    "plain ascii line, long enough to fill a vector register or two\n"
+    "\xC5\xBE\x6C\x75\x74\xC3\xBD k\xC5\xAF\xC5\x88 \xE2\x82\xAC 42 \xF0\x9F\x98\x80!\n"
+    "\xC2\xA0\xE2\x80\x83\xE3\x80\x80word \xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82\n";
+
+// Reference - decodes one codepoint at a time.
+void decodeAll( const std::string& str, std::vector< char32_t >& cps ){
+    const char* p = str.data(), *end = p + str.size();
+    while( p < end ){
+        char32_t cp;
+        size_t len = gtools::ScanTools::decodeUtf8( p, end, cp );
+        assert( len );
+        cps.push_back( cp );
+        p += len;
+    }
+}
+
+void testDecodeUtf8(){
+    using gtools::ScanTools::decodeUtf8;
+    char32_t cp;
+    const char* s;
+
+    s = "\xE2\x82\xAC";
+    assert( decodeUtf8( s, s + 3, cp ) == 3 && cp == 0x20AC );
+    s = "\xF4\x8F\xBF\xBF";
+    assert( decodeUtf8( s, s + 4, cp ) == 4 && cp == 0x10FFFF );
+
+    // Truncated, overlong, surrogate, out of range, stray continuation.
+    assert( !decodeUtf8( s, s + 3, cp ) );
+    s = "\xC0\xAF";
+    assert( !decodeUtf8( s, s + 2, cp ) );
+    s = "\xE0\x80\xAF";
+    assert( !decodeUtf8( s, s + 3, cp ) );
+    s = "\xED\xA0\x80";
+    assert( !decodeUtf8( s, s + 3, cp ) );
+    s = "\xF4\x90\x80\x80";
+    assert( !decodeUtf8( s, s + 4, cp ) );
+    s = "\x80";
+    assert( !decodeUtf8( s, s + 1, cp ) );
+}
+
+// Vectorized kernels must agree with the scalar reference at every offset.
+void testScanKernels(){
+    std::string text;
+    for( int i = 0; i < 8; i++ )
+        text += sample;
+    const char* data = text.data();
+
+    for( size_t from = 0; from < 70; from++ ){
+        for( size_t to = text.size() - 70; to <= text.size(); to++ ){
+            const char* nonAscii = data + from;
+            while( nonAscii < data + to && !( *nonAscii & 0x80 ) )
+                nonAscii++;
+            assert( gtools::ScanTools::findNonAscii( data + from, data + to ) == nonAscii );
+
+            size_t count = 0;
+            for( const char* p = data + from; p < data + to; p++ )
+                count += ( (*p & 0xC0) != 0x80 );
+            assert( gtools::ScanTools::countCodepoints( data + from, data + to ) == count );
+        }
+    }
+
+    assert( gtools::ScanTools::validateUtf8( data, data + text.size() ) == data + text.size() );
+
+    // Invalid byte placed at every position. Replaced continuation byte
+    // makes the whole sequence invalid.
+    for( size_t i = 0; i < 200; i++ ){
+        std::string bad = text;
+        bad[ i ] = '\xFF';
+        size_t start = i;
+        while( ( text[ start ] & 0xC0 ) == 0x80 )
+            start--;
+        assert( gtools::ScanTools::validateUtf8( bad.data(), bad.data() + bad.size() ) == bad.data() + start );
+    }
+
+    // Sequence cut by the end.
+    std::string cut = text.substr( 0, text.size() - 1 ) + "\xE2\x82";
+    assert( gtools::ScanTools::validateUtf8( cut.data(), cut.data() + cut.size() ) ==
+            cut.data() + cut.size() - 2 );
+}
+
+void testCodepoints( gtools::StackReader& rdr, const std::string& text ){
+    std::vector< char32_t > expected;
+    decodeAll( text, expected );
+
+    gtools::Utf8Reader urdr( rdr );
+    char32_t cp;
+    size_t i = 0;
+    while( urdr.getCodepoint( cp ) ){
+        assert( i < expected.size() && cp == expected[ i ] );
+        i++;
+    }
+    assert( i == expected.size() );
+    assert( urdr.getInvalidCount() == 0 );
+    assert( urdr.getLine() == 3 && urdr.getColumn() == 0 );
+}
+
+void testInvalid(){
+    // Invalid sequences give one replacement each, and don't swallow the
+    // next character.
+    std::string text = "a\xFF" "b\xE2\x82" "c\xED\xA0\x80" "d\xE2\x82";
+    std::istringstream iss( text, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 4, 3 );
+    gtools::Utf8Reader urdr( rdr );
+
+    std::u32string got;
+    char32_t cp;
+    while( urdr.getCodepoint( cp ) )
+        got += cp;
+
+    if(debug){
+        std::cout<<"[ Decoded:";
+        for( char32_t c : got )
+            std::cout<<" "<< std::hex << (uint32_t)c << std::dec;
+        std::cout<<" ]\n";
+    }
+    assert( got == U"a\uFFFDb\uFFFDc\uFFFDd\uFFFD" );
+    assert( urdr.getInvalidCount() == 4 );
+    assert( urdr.getColumn() == 8 );
+}
+
+// Invalid sequences are counted alike by the codepoints and by the strings,
+// and take the same columns.
+void testInvalidCounts(){
+    const char* texts[] = { "a\xFF" "b\xE2\x82" "c\xED\xA0\x80" "d\xE2\x82",
+                            "\xE2\x82x", "\x80\x80\xC0\xAF", "\xF0\x9F\x98\xF0\x9F\x98\x80",
+                            "\xF8\x88\x80\x80\x80y\xE2", "\x80\x80x", "a\xC3\xA9\n\x80\xE2\x82\xACb\xBF" };
+    for( const char* text : texts ){
+        std::istringstream iss1( text, std::ios::in | std::ios::binary );
+        gtools::StackReader rdr1( iss1, 4, 3 );
+        gtools::Utf8Reader cpReader( rdr1 );
+        char32_t cp;
+        while( cpReader.getCodepoint( cp ) );
+
+        std::istringstream iss2( text, std::ios::in | std::ios::binary );
+        gtools::StackReader rdr2( iss2, 4, 3 );
+        gtools::Utf8Reader strReader( rdr2 );
+        std::string buf;
+        assert( strReader.getStringUntilDelim( buf, "|" ) );
+        assert( buf == text );
+
+        if(debug) std::cout<<"[ Invalid: "<< cpReader.getInvalidCount() <<" by codepoints, "
+                           << strReader.getInvalidCount() <<" by string; column "
+                           << cpReader.getColumn() <<", "<< strReader.getColumn() <<" ]\n";
+        assert( cpReader.getInvalidCount() == strReader.getInvalidCount() );
+        assert( cpReader.getLine() == strReader.getLine() );
+        assert( cpReader.getColumn() == strReader.getColumn() );
+    }
+}
+
+void testWhitespace(){
+    std::istringstream iss( sample, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 4, 5 );
+    gtools::Utf8Reader urdr( rdr );
+
+    std::string line;
+    assert( urdr.getStringUntilDelim( line, "\n" ) );
+    assert( urdr.getLine() == 0 && urdr.getColumn() == line.size() );
+
+    // Second line starts with no space, and ends with "!".
+    char32_t cp;
+    assert( urdr.skipWhitespace() );
+    assert( urdr.getLine() == 1 && urdr.getColumn() == 0 );
+    line.clear();
+    assert( urdr.getStringUntilDelim( line, "!" ) );
+    if(debug) std::cout<<"[ Line 2: \""<< line <<"\", column "<< urdr.getColumn() <<" ]\n";
+    assert( urdr.getColumn() == 16 );
+    assert( urdr.getCodepoint( cp ) && cp == '!' );
+
+    // Newline and the Unicode spaces are skipped, the Cyrillic is not.
+    assert( urdr.skipWhitespace() );
+    assert( urdr.getLine() == 2 && urdr.getColumn() == 3 );
+    assert( urdr.getCodepoint( cp ) && cp == 'w' );
+    line.clear();
+    assert( urdr.getStringUntilDelim( line, " " ) );
+    assert( urdr.skipWhitespace() );
+    assert( urdr.getColumn() == 8 );
+    assert( urdr.getCodepoint( cp ) && cp == 0x41F );
+
+    assert( urdr.getStringUntilDelim( line, "\n" ) );
+    assert( !urdr.skipWhitespace() );
+    assert( urdr.getLine() == 3 && urdr.getColumn() == 0 );
+}
+
+void testValidate(){
+    std::string text;
+    for( int i = 0; i < 100; i++ )
+        text += sample;
+
+    // Small buffer cuts the sequences between the windows.
+    std::istringstream iss( text, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 8, 37 );
+    gtools::Utf8Reader urdr( rdr );
+    assert( urdr.validate() );
+    assert( urdr.getLine() == 300 && urdr.getColumn() == 0 );
+
+    // Stops at the invalid sequence, leaving it unread.
+    std::string bad = text.substr( 0, 1000 ) + "xy\xC3(" + text.substr( 1000 );
+    gtools::MemorySource src( bad.data(), bad.size() );
+    gtools::StackReader brdr( src, 8, 37 );
+    gtools::Utf8Reader burdr( brdr );
+    assert( !burdr.validate() );
+
+    std::vector< char32_t > prefix;
+    decodeAll( bad.substr( 0, 1002 ), prefix );
+    size_t column = 0;
+    for( char32_t c : prefix )
+        column = ( c == '\n' ? 0 : column + 1 );
+    if(debug) std::cout<<"[ Invalid at "<< burdr.getLine() <<":"<< burdr.getColumn() <<" ]\n";
+    assert( burdr.getColumn() == column );
+
+    char c;
+    assert( brdr.getChar( c ) && c == '\xC3' );
+}
+
+int main( int argc, char** argv ){
+    if( argc > 1 ){
+        if( !strcmp( argv[1], "-v") || !strcmp( argv[1], "--debug") ||
+            !strcmp( argv[1], "--verbose") )
+            debug = true;
+    }
+
+    std::cout<<"[ Testing gtools::Utf8Reader  ] ... ";
+    if(debug) std::cout<<"\n";
+
+    testDecodeUtf8();
+    testScanKernels();
+
+    std::istringstream iss( sample, std::ios::in | std::ios::binary );
+    gtools::StackReader rdr( iss, 4, 3 );
+    testCodepoints( rdr, sample );
+
+    gtools::MemorySource src( sample.data(), sample.size() );
+    gtools::StackReader mrdr( src );
+    testCodepoints( mrdr, sample );
+
+    testInvalid();
+    testInvalidCounts();
+    testWhitespace();
+    testValidate();
+
+    std::cout<<"[ Passed! ]\n";
+
+    return 0;
+}
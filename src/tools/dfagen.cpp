@@ -0,0 +1,182 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cctype>
+#include <gryltools/lexer.hpp>
+#include <gryltools/printtools.hpp>
+
+/*! Lexer DFA table generator.
+ *  Builds the DFA of the token grammar ahead of time, and writes it as a
+ *  header of constexpr arrays, so that binaries don't compile regexes at
+ *  startup.
+ *
+ *  Usage: dfagen <grammar> <output.hpp> [namespace]
+ *
+ *  Grammar file has a rule per line - token's name, whitespace, and it's
+ *  regex (rest of the line). Token ids are given in the order of rules, and
+ *  earlier rules win on equal-length matches. Empty lines, and lines
+ *  starting with '#' are skipped.
+ */
+
+struct GrammarRule{
+    std::string name;
+    std::string regex;
+    size_t line;
+};
+
+static bool isIdentifier( const std::string& str ){
+    if( str.empty() || std::isdigit( (unsigned char)str[0] ) )
+        return false;
+    for( char c : str ){
+        if( !std::isalnum( (unsigned char)c ) && c != '_' )
+            return false;
+    }
+    return true;
+}
+
+bool readGrammar( std::istream& in, std::vector< GrammarRule >& rules ){
+    std::string line;
+    for( size_t lineNo = 1; std::getline( in, line ); lineNo++ ){
+        if( !line.empty() && line.back() == '\r' )
+            line.pop_back();
+
+        size_t start = line.find_first_not_of( " \t" );
+        if( start == std::string::npos || line[ start ] == '#' )
+            continue;
+
+        size_t nameEnd = line.find_first_of( " \t", start );
+        size_t regexStart = ( nameEnd == std::string::npos ?
+                              nameEnd : line.find_first_not_of( " \t", nameEnd ) );
+        if( regexStart == std::string::npos ){
+            std::cerr<<"Line "<< lineNo <<": expected a token name and a regex.\n";
+            return false;
+        }
+
+        GrammarRule rule{ line.substr( start, nameEnd - start ), line.substr( regexStart ), lineNo };
+        if( !isIdentifier( rule.name ) ){
+            std::cerr<<"Line "<< lineNo <<": invalid token name \""<< rule.name <<"\".\n";
+            return false;
+        }
+        rules.push_back( rule );
+    }
+    return true;
+}
+
+// Writes the string as a C string literal.
+static void printStringLiteral( std::ostream& os, const std::string& str ){
+    os << '"';
+    for( char c : str ){
+        if( c == '"' || c == '\\' )
+            os << '\\';
+        os << c;
+    }
+    os << '"';
+}
+
+template< typename T >
+void printNumber( std::ostream& os, const T& val, const gtools::PrintTools::ListOutputParams& ){
+    os << (long long)val;
+}
+
+template< typename Container >
+void writeArray( std::ostream& out, const char* type, const char* name, const Container& data,
+                 size_t lineElems ){
+    out << "constexpr " << type << " " << name << "[" << data.size() << "] = ";
+    gtools::PrintTools::outputInitializerList( out, data.begin(), data.end(),
+        printNumber< typename Container::value_type >,
+        gtools::PrintTools::ListOutputParams( 4, lineElems ) );
+    out << ";\n\n";
+}
+
+void writeTables( std::ostream& out, const gtools::DfaBuilder& builder,
+                  const std::vector< GrammarRule >& rules, const std::string& ns,
+                  const std::string& grammarPath ){
+    std::string guard = ns;
+    for( auto& c : guard )
+        c = (char)std::toupper( (unsigned char)c );
+    guard += "_DFA_TABLES_HPP_INCLUDED";
+
+    out << "// Generated by dfagen from \"" << grammarPath << "\". Do not edit.\n\n"
+        << "#ifndef " << guard << "\n#define " << guard << "\n\n"
+        << "#include <cstdint>\n#include <gryltools/lexer.hpp>\n\n"
+        << "namespace " << ns << "{\n\n";
+
+    out << "enum TokenId : int32_t{\n";
+    for( size_t i = 0; i < rules.size(); i++ )
+        out << "    " << rules[i].name << " = " << i << ( i + 1 < rules.size() ? ",\n" : "\n" );
+    out << "};\n\n";
+
+    out << "constexpr const char* tokenNames[" << rules.size() << "] = ";
+    gtools::PrintTools::outputInitializerList( out, rules.begin(), rules.end(),
+        []( std::ostream& os, const GrammarRule& rule, const gtools::PrintTools::ListOutputParams& ){
+            printStringLiteral( os, rule.name );
+        }, gtools::PrintTools::ListOutputParams( 4, 8 ) );
+    out << ";\n\n";
+
+    // Source regexes, to rebuild or extend the automaton at runtime.
+    out << "constexpr const char* tokenRegexes[" << rules.size() << "] = ";
+    gtools::PrintTools::outputInitializerList( out, rules.begin(), rules.end(),
+        []( std::ostream& os, const GrammarRule& rule, const gtools::PrintTools::ListOutputParams& ){
+            printStringLiteral( os, rule.regex );
+        }, gtools::PrintTools::ListOutputParams( 4 ) );
+    out << ";\n\n";
+
+    writeArray( out, "uint8_t", "classMap", builder.getClassMap(), 16 );
+    writeArray( out, "uint32_t", "transitions", builder.getTransitions(), builder.getClassCount() );
+    writeArray( out, "int32_t", "tokenIds", builder.getTokenIds(), 16 );
+
+    out << "constexpr gtools::DfaTables tables = { classMap, transitions, tokenIds, "
+        << builder.getStateCount() << ", " << builder.getClassCount() << " };\n\n"
+        << "}\n\n#endif // " << guard << "\n";
+}
+
+int main( int argc, char** argv ){
+    if( argc < 3 ){
+        std::cerr<<"Usage: "<< argv[0] <<" <grammar> <output.hpp> [namespace]\n";
+        return 1;
+    }
+
+    std::string ns = ( argc > 3 ? argv[3] : "lexertables" );
+    if( !isIdentifier( ns ) ){
+        std::cerr<<"Invalid namespace \""<< ns <<"\".\n";
+        return 1;
+    }
+
+    std::ifstream in( argv[1] );
+    if( !in ){
+        std::cerr<<"Can't open grammar \""<< argv[1] <<"\".\n";
+        return 1;
+    }
+
+    std::vector< GrammarRule > rules;
+    if( !readGrammar( in, rules ) )
+        return 1;
+
+    gtools::DfaBuilder builder;
+    for( size_t i = 0; i < rules.size(); i++ ){
+        if( !builder.addRule( (int32_t)i, rules[i].regex ) ){
+            std::cerr<<"Line "<< rules[i].line <<": "<< builder.getLastError() <<"\n";
+            return 1;
+        }
+    }
+    if( !builder.build() ){
+        std::cerr<< builder.getLastError() <<"\n";
+        return 1;
+    }
+
+    // Write to memory first, so that a failed run doesn't leave a broken header.
+    std::ostringstream tables;
+    writeTables( tables, builder, rules, ns, argv[1] );
+
+    std::ofstream out( argv[2], std::ios::out | std::ios::binary );
+    if( !out || !( out << tables.str() ) ){
+        std::cerr<<"Can't write \""<< argv[2] <<"\".\n";
+        return 1;
+    }
+
+    std::cout<<"[ dfagen ]: "<< rules.size() <<" rules, "<< builder.getStateCount()
+             <<" states, "<< builder.getClassCount() <<" byte classes.\n";
+    return 0;
+}